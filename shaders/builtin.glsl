@@ -106,3 +106,25 @@ float rand(vec2 co)
 	return fract(sin(sn) * c);
 }
 // <<<<<<<<
+
+/*
+	Geomorphing of CubeSphere patches (vertex shaders only): blends the vertex
+	towards its position in the next coarser level (gl_MultiTexCoord1) between
+	the distances morph_start and morph_end from the camera (morph_campos)
+*/
+#ifdef VERTEX_SHADER
+uniform vec3 morph_campos;
+uniform float morph_start;
+uniform float morph_end;
+
+vec4 morphVertex()
+{
+	// no morphing, also prevents a division by zero if the uniforms are not set
+	if (morph_end <= morph_start) return gl_Vertex;
+
+	float dist = distance(gl_Vertex.xyz, morph_campos);
+	float morph = clamp((dist - morph_start) / (morph_end - morph_start), 0.0, 1.0);
+
+	return vec4(mix(gl_Vertex.xyz, gl_MultiTexCoord1.xyz, morph), 1.0);
+}
+#endif
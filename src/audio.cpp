@@ -114,11 +114,8 @@ void AudioEnvironment::step ()
 
 	// Update AudioNodes that are bound to objects, so that there is
 	// hardly any delay between listener update and source udpate
-	for (auto obj : game->getWorldEnv()->getObjects())
-	{
-		AudioObject *audio = dynamic_cast<AudioObject *>(obj);
-		if (audio) audio->stepAudio();
-	}
+	for (auto &audio : game->getWorldEnv()->getAudioObjects())
+		audio.iface->stepAudio();
 }
 
 /**
@@ -1,5 +1,7 @@
 #include <algorithm>
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <math.h>
 #include <string>
 #include <vector>
@@ -7,18 +9,24 @@
 #include "gllibs.hpp"
 
 #include "environment.hpp"
+#include "renderqueue.hpp"
+#include "resolution.hpp"
+#include "framepacer.hpp"
+#include "capture.hpp"
 #include "spaceship.hpp"
 #include "gamevars.hpp"
 #include "objects.hpp"
+#include "glstate.hpp"
 #include "config.hpp"
 #include "camera.hpp"
 #include "player.hpp"
 #include "shader.hpp"
-#include "shader.hpp"
 #include "skybox.hpp"
 #include "debug.hpp"
 #include "game.hpp"
 #include "util.hpp"
+#include "lightregistry.hpp"
+#include "lod.hpp"
 
 /**
  * \brief The Camera renders objects on the screen based on the player's view
@@ -40,7 +48,10 @@ m_player(player),
 m_shaderman(shaderman),
 m_skybox(skybox),
 m_framecounter(new FrameCounter()),
-m_capture_mouse(true)
+m_capture_mouse(true),
+m_occlusion_culling(config->getBool("occlusion_culling", true)),
+m_resolution(new ResolutionScaler()),
+m_capture(new FrameCapture())
 {
 }
 
@@ -51,6 +62,8 @@ Camera::~Camera()
 {
 	delete m_framecounter;
 	m_framecounter = nullptr;
+	delete m_resolution;
+	delete m_capture;
 
 	std::cout<<"~Camera"<<std::endl;
 }
@@ -69,13 +82,17 @@ void Camera::render()
 	glClearColor(0, 0, 0, 0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	// In dynamic resolution mode, the world is rendered offscreen with a smaller size
+	int render_w, render_h;
+	m_resolution->begin(window_w, window_h, render_w, render_h);
+
 	/*********************************
 		Static World Matrix
 	*********************************/
 	if (!config->getBool("enable_anaglyph", false))
 	{
 		// Normal mode, render the scene without any color mask / offset
-		beginStaticWorldMatrix(window_w, window_h);
+		beginStaticWorldMatrix(render_w, render_h);
 		{
 			m_skybox->render();
 		}
@@ -86,7 +103,7 @@ void Camera::render()
 		// Render two scenes, one in red and the other in cyan
 
 		// Left eye (red)
-		beginStaticWorldMatrix(window_w, window_h, CAMERA_EYE_LEFT);
+		beginStaticWorldMatrix(render_w, render_h, CAMERA_EYE_LEFT);
 		{
 			glColorMask(true, false, false, false);
 			m_skybox->render();
@@ -94,7 +111,7 @@ void Camera::render()
 		endStaticWorldMatrix();
 
 		// Right eye (cyan)
-		beginStaticWorldMatrix(window_w, window_h, CAMERA_EYE_RIGHT);
+		beginStaticWorldMatrix(render_w, render_h, CAMERA_EYE_RIGHT);
 		{
 			glColorMask(false, true, true, false);
 			m_skybox->render();
@@ -105,13 +122,16 @@ void Camera::render()
 	/***************************
 		World Matrix
 	***************************/
+	// Queued and sorted once, drawn once per eye in anaglyph mode
+	prepareWorldMatrix();
+
 	if (!config->getBool("enable_anaglyph", false))
 	{
 		// Normal mode, render the scene without any color mask / offset
-		beginWorldMatrix(window_w, window_h);
+		beginWorldMatrix(render_w, render_h);
 		{
 			for (auto obj : m_static_env->getObjects())
-				obj->whileWorldMatrix(window_w, window_h);
+				obj->whileWorldMatrix(render_w, render_h);
 			renderWorldMatrix();
 		}
 		endWorldMatrix();
@@ -121,18 +141,18 @@ void Camera::render()
 		// Render two scenes, one in red and the other in cyan
 
 		// Left eye (red)
-		beginWorldMatrix(window_w, window_h, CAMERA_EYE_LEFT);
+		beginWorldMatrix(render_w, render_h, CAMERA_EYE_LEFT);
 		{
 			glColorMask(true, false, false, false);
 			for (auto obj : m_static_env->getObjects())
-				obj->whileWorldMatrix(window_w, window_h);
+				obj->whileWorldMatrix(render_w, render_h);
 			renderWorldMatrix();
 		}
 		endWorldMatrix();
 		glClear(GL_DEPTH_BUFFER_BIT) ;
 	
 		// Right eye (cyan)
-		beginWorldMatrix(window_w, window_h, CAMERA_EYE_RIGHT);
+		beginWorldMatrix(render_w, render_h, CAMERA_EYE_RIGHT);
 		{
 			glColorMask(false, true, true, false);
 			renderWorldMatrix();
@@ -142,6 +162,8 @@ void Camera::render()
 		glColorMask(true, true, true, true);
 	}
 
+	m_resolution->end(window_w, window_h);
+
 	/*****************************
 		Static Matrix
 	******************************/
@@ -157,10 +179,16 @@ void Camera::render()
 	}
 	endStaticMatrix();
 
+	m_capture->step(window_w, window_h);
+
+	// Only the time spent on this frame, waiting for the next one must not lower the scale
+	m_resolution->addFrameTime(game->getFramePacer()->getWorkTime());
+
 	glFlush();
 	glutSwapBuffers();
 
 	m_framecounter->dispFrame();
+	GLState::endFrame();
 }
 
 /*
@@ -182,22 +210,21 @@ void Camera::beginWorldMatrix(int window_w, int window_h, camera_eye eye)
 	glLoadIdentity();
 
 	glViewport(0, 0, window_w, window_h);
-	gluPerspective(45, window_w * 1.0 / window_h, USC * 100, BACKPLANE);
+	gluPerspective(CAMERA_FOV, window_w * 1.0 / window_h, USC * 100, BACKPLANE);
+	game->getLodManager()->setViewport(window_h, CAMERA_FOV);
 
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
-	glEnable (GL_DEPTH		);
-	glEnable (GL_DEPTH_TEST		);
-	glEnable (GL_CULL_FACE		);
-	glEnable (GL_BLEND		);
-	glEnable (GL_LIGHTING		);
-	glEnable (GL_SMOOTH		);
-	glEnable (GL_NORMALIZE		);
-	glEnable (GL_COLOR_MATERIAL	);
+	GLState::enable (GL_DEPTH_TEST		);
+	GLState::enable (GL_CULL_FACE		);
+	GLState::enable (GL_BLEND		);
+	GLState::enable (GL_LIGHTING		);
+	GLState::enable (GL_NORMALIZE		);
+	GLState::enable (GL_COLOR_MATERIAL	);
 
-	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glShadeModel(GL_SMOOTH);
+	GLState::blendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::shadeModel(GL_SMOOTH);
 
 	SimpleVec3d lookaxis = m_player->getLookAxis() * 10.0;
 	SimpleVec3d upaxis = m_player->getUpAxis();
@@ -226,47 +253,86 @@ void Camera::beginWorldMatrix(int window_w, int window_h, camera_eye eye)
  */
 void Camera::endWorldMatrix()
 {
-	glDisable (GL_DEPTH		);
-	glDisable (GL_DEPTH_TEST	);
-	glDisable (GL_CULL_FACE		);
-	glDisable (GL_BLEND		);
-	glDisable (GL_LIGHTING		);
-	glDisable (GL_SMOOTH		);
-	glDisable (GL_COLOR_MATERIAL	);
+	GLState::disable (GL_DEPTH_TEST		);
+	GLState::disable (GL_CULL_FACE		);
+	GLState::disable (GL_BLEND		);
+	GLState::disable (GL_LIGHTING		);
+	GLState::disable (GL_COLOR_MATERIAL	);
+}
+
+/**
+ * \brief Puts all objects in the WorldEnvironment into the RenderQueue and sorts it
+ *
+ * Objects that are hidden behind an occluder (see WorldObject::getOccluderRadius) are left
+ * out. The positions relative to the player, the order and the lights do not depend on the
+ * eye, so this is only done once per frame, also in Anaglyph mode.
+ */
+void Camera::prepareWorldMatrix()
+{
+	const std::vector<WorldObject*> &objects = m_world_env->getObjects();
+	SimpleVec3d campos = m_player->getPos();
+
+	m_occlusion.clear();
+	if (m_occlusion_culling)
+	{
+		for (auto obj : objects)
+			m_occlusion.addOccluder(obj->getPos() - campos, obj->getOccluderRadius());
+	}
+
+	m_renderqueue.clear();
+	for (auto obj : objects)
+	{
+		SimpleVec3d relpos = obj->getPos() - campos;
+		if (m_occlusion.isOccluded(relpos, obj->getBoundingRadius())) continue;
+
+		if (obj->getShaderID() < 0)
+			obj->setShaderID(m_shaderman->getShaderID(obj->getShaderName()));
+
+		m_renderqueue.push(obj, relpos, RENDER_PASS_WORLD,
+			obj->getTranslucent(), obj->getShaderID(), obj->getMaterial());
+	}
+	m_renderqueue.sort();
+
+	game->getLightRegistry()->select(m_player->getPos());
 }
 
 /**
- * \brief Renders the WorldEnvironment
+ * \brief Renders the WorldEnvironment as prepared by prepareWorldMatrix()
  *
- * Iterates through all objects in the WorldEnvironment, translates them and renders them.
- * This is a seperate function as it has to be called twice in Anaglyph mode.
+ * Translates the objects and renders them in the order of their sort keys. Shaders and
+ * materials are only changed if the next object needs a different one. This is a seperate
+ * function as it has to be called twice in Anaglyph mode.
  */
 void Camera::renderWorldMatrix()
 {
-	std::vector<WorldObject*> worldobjects = m_world_env->getObjects();
-	std::sort(worldobjects.begin(), worldobjects.end(), compareDistances);
+	std::vector<RenderItem> &items = m_renderqueue.getItems();
 
-	// Lighting enable
-	for (auto obj : worldobjects)
-		obj->getLightSpec().render((obj->getPos() - m_player->getPos()));
+	game->getLightRegistry()->render();
 
 	// Render objects
-	for (auto obj : worldobjects)
+	uint16_t material = MATERIAL_DEFAULT;
+	for (auto &item : items)
 	{
+		// Objects of the same material group set their material parameters themselves
+		if (item.material != material && material != MATERIAL_DEFAULT)
+			resetMaterial();
+		material = item.material;
+
+		m_shaderman->requestShader(item.shader);
+
 		glPushMatrix();
 		{
-			(obj->getPos() - m_player->getPos()).translate();
-			obj->render();
-
-			resetMaterial();
-			m_shaderman->resetShader();
+			item.relpos.translate();
+			item.obj->render();
 		}
 		glPopMatrix();
 	}
 
-	// Lighting disable
-	for (auto obj : worldobjects)
-		obj->getLightSpec().disable();
+	if (material != MATERIAL_DEFAULT)
+		resetMaterial();
+	m_shaderman->resetShader();
+
+	game->getLightRegistry()->disable();
 }
 
 
@@ -288,22 +354,20 @@ void Camera::beginStaticWorldMatrix(int window_w, int window_h, camera_eye eye)
 	glLoadIdentity();
 
 	glViewport(0, 0, window_w, window_h);
-	gluPerspective(45, window_w * 1.0 / window_h, USC*0.00001, BACKPLANE);
+	gluPerspective(CAMERA_FOV, window_w * 1.0 / window_h, USC*0.00001, BACKPLANE);
 
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
-	glEnable (GL_DEPTH		);
-	glEnable (GL_DEPTH_TEST		);
-	glEnable (GL_CULL_FACE		);
-	glEnable (GL_BLEND		);
-	glEnable (GL_LIGHTING		);
-	glEnable (GL_SMOOTH		);
-	glEnable (GL_NORMALIZE		);
-	glEnable (GL_COLOR_MATERIAL	);
+	GLState::enable (GL_DEPTH_TEST		);
+	GLState::enable (GL_CULL_FACE		);
+	GLState::enable (GL_BLEND		);
+	GLState::enable (GL_LIGHTING		);
+	GLState::enable (GL_NORMALIZE		);
+	GLState::enable (GL_COLOR_MATERIAL	);
 
-	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glShadeModel(GL_SMOOTH);
+	GLState::blendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::shadeModel(GL_SMOOTH);
 
 	SimpleVec3d lookdir = m_player->getLookAxis();
 	SimpleVec3d upaxis = m_player->getUpAxis();
@@ -325,13 +389,11 @@ void Camera::beginStaticWorldMatrix(int window_w, int window_h, camera_eye eye)
  */
 void Camera::endStaticWorldMatrix()
 {
-	glDisable (GL_DEPTH		);
-	glDisable (GL_DEPTH_TEST	);
-	glDisable (GL_CULL_FACE		);
-	glDisable (GL_BLEND		);
-	glDisable (GL_LIGHTING		);
-	glDisable (GL_SMOOTH		);
-	glDisable (GL_COLOR_MATERIAL	);
+	GLState::disable (GL_DEPTH_TEST		);
+	GLState::disable (GL_CULL_FACE		);
+	GLState::disable (GL_BLEND		);
+	GLState::disable (GL_LIGHTING		);
+	GLState::disable (GL_COLOR_MATERIAL	);
 }
 
 /**
@@ -352,8 +414,8 @@ void Camera::beginStaticMatrix(int window_w, int window_h)
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
-	glEnable (GL_BLEND);
-	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::enable (GL_BLEND);
+	GLState::blendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 /**
@@ -364,29 +426,13 @@ void Camera::beginStaticMatrix(int window_w, int window_h)
  */
 void Camera::endStaticMatrix()
 {
-	glDisable(GL_BLEND);
+	GLState::disable(GL_BLEND);
 	glMatrixMode(GL_PROJECTION);
 	glPopMatrix();
 	glMatrixMode(GL_MODELVIEW);
 }
 
 
-/**
- * \brief Compares distances of two WorldObjects
- * \param obj1 The first object to be compared
- * \param obj2 The second object to be compared
- * \return Returns true if the distance of obj1 to the player is greater than that of obj2
- *
- * This is a helper function that is used for the sorting algorithm of WorldObjects in render()
- */
-bool Camera::compareDistances(WorldObject* obj1, WorldObject* obj2)
-{
-	float obj1_d = getVectorLength(game->getCamera()->getPlayer()->getPos() - obj1->getPos());
-	float obj2_d = getVectorLength(game->getCamera()->getPlayer()->getPos() - obj2->getPos());
-
-	return obj1_d > obj2_d;
-}
-
 /*
 	Class FrameCounter
 */
@@ -429,7 +475,21 @@ void FrameCounter::onTimerElapse(int ignore)
  */
 void FrameCounter::update_fps(void) // Display FPS in title bar
 {
-	std::string title = std::string(APPLICATION_NAME) + " (FPS: " + std::to_string(m_fps) + ")";
+	FramePacer *pacer = game->getFramePacer();
+	std::ostringstream frametime;
+	frametime << std::fixed << std::setprecision(1) << pacer->getFrameTimeMean() * 1000
+		<< " +- " << pacer->getFrameTimeDeviation() * 1000 << " ms";
+
+	std::string title = std::string(APPLICATION_NAME) + " (FPS: " + std::to_string(m_fps)
+		+ ", frame time: " + frametime.str()
+		+ ", skipped GL calls: " + std::to_string(GLState::getSkippedNum())
+		+ ", occluded: " + std::to_string(game->getCamera()->getCulledNum());
+
+	ResolutionScaler *resolution = game->getCamera()->getResolutionScaler();
+	if (resolution->getEnabled())
+		title += ", resolution: " + std::to_string((int)round(resolution->getScale() * 100)) + "%";
+
+	title += ")";
 	glutSetWindowTitle(title.c_str());
 }
 
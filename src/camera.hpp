@@ -4,16 +4,23 @@
 #include <iostream>
 #include <string>
 
+#include "renderqueue.hpp"
+#include "occlusion.hpp"
 #include "util.hpp"
 
 class StaticEnvironment;
 class WorldEnvironment;
 class ShaderManager;
+class ResolutionScaler;
+class FrameCapture;
 class FrameCounter;
 class WorldObject;
 class SkyBox;
 class Player;
 
+// Vertical field of view in degrees
+#define CAMERA_FOV 45
+
 /**
  * \brief Eye Position of the viewer
  *
@@ -102,10 +109,19 @@ class Camera
 		FrameCounter *getFrameCounter()
 			{ return m_framecounter; }
 
+		/// The ResolutionScaler for the world, see begin() and end() there
+		ResolutionScaler *getResolutionScaler()
+			{ return m_resolution; }
+
+		/// Number of objects hidden by occlusion culling in the last frame
+		uint32_t getCulledNum()
+			{ return m_occlusion.getCulledNum(); }
+
 	private:
 		void beginWorldMatrix(int window_w, int window_h,
 			camera_eye eye = CAMERA_EYE_CENTER);
 		void endWorldMatrix();
+		void prepareWorldMatrix();
 		void renderWorldMatrix();
 
 		void beginStaticMatrix(int window_w, int window_h);
@@ -115,8 +131,6 @@ class Camera
 			camera_eye eye = CAMERA_EYE_CENTER);
 		void endStaticWorldMatrix();
 
-		static bool compareDistances(WorldObject* obj1, WorldObject* obj2);
-
 		// Reference to the associated WorldEnvironment
 		WorldEnvironment *m_world_env;
 
@@ -137,6 +151,19 @@ class Camera
 
 		// True if the mouse is to be captured, otherwise false; default is true
 		bool m_capture_mouse;
+
+		// Sorted list of WorldObjects to render, rebuilt every frame
+		RenderQueue m_renderqueue;
+
+		// Stars and Planets that hide objects behind them, rebuilt every frame
+		bool m_occlusion_culling;
+		OcclusionCuller m_occlusion;
+
+		// Renders the world offscreen in dynamic resolution mode
+		ResolutionScaler *m_resolution;
+
+		// Saves screenshots and image sequences of the rendered frames
+		FrameCapture *m_capture;
 };
 
 /// Counts the FPS of the game and displays them in the title bar
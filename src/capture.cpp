@@ -0,0 +1,344 @@
+#include <iostream>
+#include <stdio.h>
+#include <chrono>
+#include <ctime>
+
+#include "gamevars.hpp"
+#include "keyboard.hpp"
+#include "capture.hpp"
+#include "config.hpp"
+#include "util.hpp"
+
+// Maximum number of synchronously read images waiting for the writer thread
+#define CAPTURE_QUEUE_MAX 4
+
+/// Returns the local time as YYYYMMDD-HHMMSS-mmm (milliseconds), for file names
+static std::string getTimestamp()
+{
+	auto now = std::chrono::system_clock::now();
+	time_t seconds = std::chrono::system_clock::to_time_t(now);
+	int millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+		now.time_since_epoch()).count() % 1000;
+
+	char timestamp[32];
+	size_t len = strftime(timestamp, sizeof(timestamp), "%Y%m%d-%H%M%S", localtime(&seconds));
+	snprintf(timestamp + len, sizeof(timestamp) - len, "-%03d", millis);
+	return timestamp;
+}
+
+/**
+ * \brief Creates the pixel buffer objects and starts the writer thread
+ *
+ * Must be called while the OpenGL context is current.
+ */
+FrameCapture::FrameCapture() :
+m_supported(isSupported()),
+m_dir(getBasedir() + CAPTURE_DIR),
+m_dir_created(false),
+m_screenshot(false),
+m_recording(false),
+m_record_frame(0),
+m_dropped(0),
+m_next_slot(0),
+m_running(true)
+{
+	for (auto &slot : m_slots)
+	{
+		slot.pbo = 0;
+		slot.fence = 0;
+		slot.state = CAPTURE_SLOT_FREE;
+		slot.width = slot.height = 0;
+		if (m_supported) glGenBuffers(1, &slot.pbo);
+	}
+
+	m_writer = std::thread(&FrameCapture::writerThread, this);
+	keyboard->registerSpecialKeyPressCallback(onSpecialKeyPress_wrapper, this);
+}
+
+/**
+ * \brief Writes the queued images, then deletes the pixel buffer objects
+ *
+ * Frames that are still being transferred are discarded.
+ */
+FrameCapture::~FrameCapture()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_cond.notify_one();
+	m_writer.join();
+
+	for (auto &slot : m_slots)
+	{
+		if (slot.fence != 0) glDeleteSync(slot.fence);
+		if (slot.state == CAPTURE_SLOT_CONVERTED)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		if (slot.pbo != 0) glDeleteBuffers(1, &slot.pbo);
+	}
+	if (m_supported) glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * \brief Returns true if the driver supports pixel buffer objects and fences
+ */
+bool FrameCapture::isSupported()
+{
+	return (GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+}
+
+/// Wrapper function that calls onSpecialKeyPress
+void FrameCapture::onSpecialKeyPress_wrapper(int key, void *self)
+{
+	((FrameCapture*) self)->onSpecialKeyPress(key);
+}
+
+/**
+ * \brief Takes a screenshot when F11 is pressed, starts / stops recording with F12
+ */
+void FrameCapture::onSpecialKeyPress(int key)
+{
+	if (key == GLUT_KEY_F11) takeScreenshot();
+	if (key == GLUT_KEY_F12) toggleRecording();
+}
+
+/**
+ * \brief Creates the capture directory, unless that has been done before
+ *
+ * Called by the main thread before the first image is requested, so that the writer
+ * thread does not have to check for it with every frame.
+ */
+void FrameCapture::prepareDirectory()
+{
+	if (m_dir_created) return;
+
+	m_dir_created = makeDirectory(m_dir);
+	if (!m_dir_created)
+		std::cout << "Could not create " << m_dir << std::endl;
+}
+
+/**
+ * \brief Saves the next frame as an image
+ */
+void FrameCapture::takeScreenshot()
+{
+	prepareDirectory();
+	m_screenshot = true;
+}
+
+/**
+ * \brief Starts or stops saving every frame as an image sequence
+ */
+void FrameCapture::toggleRecording()
+{
+	m_recording = !m_recording;
+	if (m_recording)
+	{
+		prepareDirectory();
+		m_record_name = "recording-" + getTimestamp();
+		m_record_frame = 0;
+		m_dropped = 0;
+		std::cout << "Recording to " << m_dir << m_record_name << "-*.tga" << std::endl;
+	}
+	else
+	{
+		std::cout << "Recording stopped: " << m_record_frame << " frames, "
+			<< m_dropped << " dropped" << std::endl;
+	}
+}
+
+/**
+ * \brief Captures the current frame if requested, to be called before the buffer swap
+ * \param window_w The window width
+ * \param window_h The window height
+ *
+ * Also hands finished transfers over to the writer thread and recycles the slots
+ * the writer thread is done with.
+ */
+void FrameCapture::step(int window_w, int window_h)
+{
+	if (m_supported) processSlots();
+
+	// If all slots are busy, the screenshot is taken in one of the next frames
+	if (m_screenshot)
+	{
+		std::string filename = m_dir + "screenshot-" + getTimestamp() + ".tga";
+		if (readFrame(window_w, window_h, filename))
+		{
+			std::cout << "Screenshot: " << filename << std::endl;
+			m_screenshot = false;
+		}
+	}
+
+	if (m_recording)
+	{
+		char frame[16];
+		snprintf(frame, sizeof(frame), "-%06u.tga", m_record_frame++);
+		readFrame(window_w, window_h, m_dir + m_record_name + frame);
+	}
+}
+
+/**
+ * \brief Maps slots whose transfer has completed and unmaps converted ones, never waits
+ */
+void FrameCapture::processSlots()
+{
+	for (uint8_t i = 0; i < CAPTURE_SLOTS; i++)
+	{
+		CaptureSlot &slot = m_slots[i];
+
+		if (slot.state == CAPTURE_SLOT_CONVERTED)
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			slot.state = CAPTURE_SLOT_FREE;
+		}
+		else if (slot.state == CAPTURE_SLOT_READING)
+		{
+			GLenum status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				continue;
+
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			CaptureJob job;
+			job.slot = i;
+			job.pixels = (const uint8_t *)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+			job.width = slot.width;
+			job.height = slot.height;
+			job.filename = slot.filename;
+
+			if (job.pixels == NULL)
+			{
+				slot.state = CAPTURE_SLOT_FREE;
+				continue;
+			}
+
+			slot.state = CAPTURE_SLOT_MAPPED;
+			queueJob(std::move(job));
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+/**
+ * \brief Starts reading the framebuffer into the next free slot
+ * \param window_w The window width
+ * \param window_h The window height
+ * \param filename The file to save the frame to
+ *
+ * Returns false (and drops the frame) if the next slot is still busy.
+ */
+bool FrameCapture::readFrame(int window_w, int window_h, std::string filename)
+{
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	if (!m_supported)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_jobs.size() >= CAPTURE_QUEUE_MAX)
+			{
+				m_dropped++;
+				return false;
+			}
+		}
+
+		CaptureJob job;
+		job.slot = -1;
+		job.data.resize(window_w * window_h * 4);
+		glReadPixels(0, 0, window_w, window_h, GL_RGBA, GL_UNSIGNED_BYTE, &job.data[0]);
+		job.pixels = &job.data[0];
+		job.width = window_w;
+		job.height = window_h;
+		job.filename = filename;
+		queueJob(std::move(job));
+		return true;
+	}
+
+	CaptureSlot &slot = m_slots[m_next_slot];
+	if (slot.state != CAPTURE_SLOT_FREE)
+	{
+		m_dropped++;
+		return false;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	if (slot.width != window_w || slot.height != window_h)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, window_w * window_h * 4, NULL, GL_STREAM_READ);
+		slot.width = window_w;
+		slot.height = window_h;
+	}
+
+	// Returns immediately, the transfer happens when the GPU gets there
+	glReadPixels(0, 0, window_w, window_h, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.filename = filename;
+	slot.state = CAPTURE_SLOT_READING;
+	m_next_slot = (m_next_slot + 1) % CAPTURE_SLOTS;
+	return true;
+}
+
+/**
+ * \brief Hands an image over to the writer thread
+ * \param job The image, moved into the queue
+ */
+void FrameCapture::queueJob(CaptureJob &&job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_cond.notify_one();
+}
+
+/**
+ * \brief Converts and saves queued images, runs in m_writer
+ *
+ * The pixels are flipped (OpenGL starts with the bottom row) and the alpha channel is
+ * dropped while copying them out of the slot, which is released before the (slow)
+ * encoding and writing.
+ */
+void FrameCapture::writerThread()
+{
+	while (true)
+	{
+		CaptureJob job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cond.wait(lock, [this] { return !m_jobs.empty() || !m_running; });
+			if (m_jobs.empty()) return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+
+		std::vector<uint8_t> image(job.width * job.height * 3);
+		for (int y = 0; y < job.height; y++)
+		{
+			const uint8_t *src = job.pixels + (job.height - 1 - y) * job.width * 4;
+			uint8_t *dst = &image[y * job.width * 3];
+			for (int x = 0; x < job.width; x++)
+			{
+				dst[x * 3 + 0] = src[x * 4 + 0];
+				dst[x * 3 + 1] = src[x * 4 + 1];
+				dst[x * 3 + 2] = src[x * 4 + 2];
+			}
+		}
+
+		if (job.slot >= 0)
+			m_slots[job.slot].state = CAPTURE_SLOT_CONVERTED;
+
+		if (!SOIL_save_image(job.filename.c_str(), SOIL_SAVE_TYPE_TGA, job.width, job.height,
+				3, &image[0]))
+			std::cout << "Could not save " << job.filename << std::endl;
+	}
+}
@@ -0,0 +1,99 @@
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <condition_variable>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <deque>
+
+#include "gllibs.hpp"
+
+// Number of pixel buffer objects that frames are read into
+#define CAPTURE_SLOTS 4
+
+/// State of a CaptureSlot, a slot is only touched by the thread its state belongs to
+enum capture_slot_state
+{
+	CAPTURE_SLOT_FREE,	/** main thread: can be read into */
+	CAPTURE_SLOT_READING,	/** main thread: glReadPixels has been issued, fence pending */
+	CAPTURE_SLOT_MAPPED,	/** writer thread: mapped, the pixels are being converted */
+	CAPTURE_SLOT_CONVERTED	/** main thread: converted, to be unmapped */
+};
+
+/// Pixel buffer object in the ring of a FrameCapture
+struct CaptureSlot
+{
+	GLuint pbo;
+	GLsync fence;
+	std::atomic<uint8_t> state;	// capture_slot_state
+	int width, height;
+	std::string filename;
+};
+
+/// Image handed over to the writer thread, either mapped from a slot or owned
+struct CaptureJob
+{
+	int8_t slot;			// -1 if the pixels are in data
+	const uint8_t *pixels;		// RGBA, bottom row first
+	std::vector<uint8_t> data;
+	int width, height;
+	std::string filename;
+};
+
+/**
+ * \brief Saves screenshots (F11) and image sequences (F12) without stalling rendering
+ *
+ * Frames are read into a ring of pixel buffer objects. A fence tells when the transfer
+ * has completed, only then the buffer is mapped and handed over to the writer thread,
+ * which converts and saves the image as TGA in <basedir>/CAPTURE_DIR. If all slots are
+ * busy, the frame is dropped instead of waiting. Without pixel buffer objects and fences,
+ * the pixels are read synchronously.
+ */
+class FrameCapture
+{
+	public:
+		FrameCapture();
+		~FrameCapture();
+
+		static bool isSupported();
+
+		void takeScreenshot();
+		void toggleRecording();
+
+		void step(int window_w, int window_h);
+
+	private:
+		static void onSpecialKeyPress_wrapper(int key, void *self);
+		void onSpecialKeyPress(int key);
+
+		void prepareDirectory();
+		void processSlots();
+		bool readFrame(int window_w, int window_h, std::string filename);
+		void queueJob(CaptureJob &&job);
+		void writerThread();
+
+		bool m_supported;
+		std::string m_dir;	// <basedir>/CAPTURE_DIR
+		bool m_dir_created;
+		bool m_screenshot;
+		bool m_recording;
+		std::string m_record_name;
+		uint32_t m_record_frame;
+		uint32_t m_dropped;
+
+		CaptureSlot m_slots[CAPTURE_SLOTS];
+		uint8_t m_next_slot;
+
+		// Writer thread and its queue, protected by m_mutex
+		std::thread m_writer;
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<CaptureJob> m_jobs;
+		bool m_running;
+};
+
+#endif
@@ -88,6 +88,12 @@ class ConfigurationManager
 #define SHADER_DIR "shaders" DIR_DELIM
 #define SHADER_BUILTIN_FILENAME "builtin.glsl"
 #define BUILTIN_SHADER_PATH SHADER_DIR SHADER_BUILTIN_FILENAME
+#define SHADER_CACHE_DIR "cache" DIR_DELIM
+
+/*
+	Screenshots and recordings
+*/
+#define CAPTURE_DIR "capture" DIR_DELIM
 
 /*
 	Config file
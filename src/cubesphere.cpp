@@ -0,0 +1,552 @@
+#include <unordered_map>
+#include <algorithm>
+#include <math.h>
+
+#include "cubesphere.hpp"
+#include "gamevars.hpp"
+#include "config.hpp"
+#include "camera.hpp"
+#include "shader.hpp"
+#include "mesh.hpp"
+#include "lod.hpp"
+#include "game.hpp"
+
+// Quads are not subdivided any further when they get smaller than this (50m IRL)
+#define CUBESPHERE_MIN_QUAD (USC * 0.05)
+
+// A node is always subdivided if the camera is closer than this times the edge length of
+// the node, so that neighbouring patches differ by one level at most (see getStitch)
+#define CUBESPHERE_LOD_RANGE_MIN 1.0
+
+// Part of the LOD range of the parent level after which morphing towards it begins
+#define CUBESPHERE_MORPH_START 0.7
+
+// Position of a vertex (i, j) in the vertex array of a patch
+#define PATCH_VERTEX(i, j) ((j) * (CUBESPHERE_PATCH_SIZE + 1) + (i))
+
+// Floats per vertex: position and morph target
+#define PATCH_VERTEX_FLOATS 6
+
+/*
+	Patch keys:
+	face (3 bits) | depth (5 bits) | x (28 bits) | y (28 bits)
+*/
+#define KEY_FACE(key)	((uint8_t)((key) >> 61))
+#define KEY_DEPTH(key)	((uint8_t)(((key) >> 56) & 0x1f))
+#define KEY_X(key)	((uint32_t)(((key) >> 28) & 0xfffffff))
+#define KEY_Y(key)	((uint32_t)((key) & 0xfffffff))
+
+static inline uint64_t makeKey(uint8_t face, uint8_t depth, uint32_t x, uint32_t y)
+{
+	return ((uint64_t)face << 61) | ((uint64_t)depth << 56) | ((uint64_t)x << 28) | y;
+}
+
+/*
+	The six faces of the cube: normal n and the directions a (u) and b (v) on the face.
+	a x b = n, so that triangles with increasing u, then v are counter-clockwise when
+	looking at the face from the outside.
+*/
+struct CubeFace
+{
+	SimpleVec3d n, a, b;
+};
+
+static const CubeFace cubefaces[6] =
+{
+	{ SimpleVec3d( 1,  0,  0), SimpleVec3d(0, 1, 0), SimpleVec3d(0, 0, 1) },
+	{ SimpleVec3d(-1,  0,  0), SimpleVec3d(0, 0, 1), SimpleVec3d(0, 1, 0) },
+	{ SimpleVec3d( 0,  1,  0), SimpleVec3d(0, 0, 1), SimpleVec3d(1, 0, 0) },
+	{ SimpleVec3d( 0, -1,  0), SimpleVec3d(1, 0, 0), SimpleVec3d(0, 0, 1) },
+	{ SimpleVec3d( 0,  0,  1), SimpleVec3d(1, 0, 0), SimpleVec3d(0, 1, 0) },
+	{ SimpleVec3d( 0,  0, -1), SimpleVec3d(0, 1, 0), SimpleVec3d(1, 0, 0) }
+};
+
+/**
+ * \brief Point on the cube for face coordinates u, v in [-1, 1]
+ */
+static inline SimpleVec3d facePoint(uint8_t face, double u, double v)
+{
+	const CubeFace &f = cubefaces[face];
+	return SimpleVec3d(
+		f.n.x + f.a.x * u + f.b.x * v,
+		f.n.y + f.a.y * u + f.b.y * v,
+		f.n.z + f.a.z * u + f.b.z * v);
+}
+
+/**
+ * \brief Maps a point on the unit cube onto the unit sphere
+ *
+ * Unlike normalizing the point, this mapping keeps the area of the quads nearly
+ * constant, so that the patches close to the cube edges are not denser than the others.
+ */
+static inline SimpleVec3d spherify(SimpleVec3d c)
+{
+	double x2 = c.x * c.x, y2 = c.y * c.y, z2 = c.z * c.z;
+	return SimpleVec3d(
+		c.x * sqrt(1 - y2 / 2 - z2 / 2 + y2 * z2 / 3),
+		c.y * sqrt(1 - z2 / 2 - x2 / 2 + z2 * x2 / 3),
+		c.z * sqrt(1 - x2 / 2 - y2 / 2 + x2 * y2 / 3));
+}
+
+/**
+ * \brief Finds face and face coordinates of a point close to the cube surface
+ * \param c The point, may also be on the extension of a face beyond its edges
+ * \param face Receives the face the point belongs to
+ * \param u Receives the u face coordinate
+ * \param v Receives the v face coordinate
+ */
+static void cubeToFace(SimpleVec3d c, uint8_t *face, double *u, double *v)
+{
+	double ax = fabs(c.x), ay = fabs(c.y), az = fabs(c.z);
+
+	if (ax >= ay && ax >= az)	*face = (c.x > 0) ? 0 : 1;
+	else if (ay >= az)		*face = (c.y > 0) ? 2 : 3;
+	else				*face = (c.z > 0) ? 4 : 5;
+
+	// Project onto the face plane
+	c = c / std::max(ax, std::max(ay, az));
+	*u = dotProduct(c, cubefaces[*face].a);
+	*v = dotProduct(c, cubefaces[*face].b);
+}
+
+/**
+ * \brief Creates a new CubeSphere
+ * \param radius The radius of the sphere
+ * \param amplitude The maximum displacement of the surface by the shader, relative to the radius
+ *
+ * No patches are selected before the first call to update(), so nothing is drawn until then.
+ */
+CubeSphere::CubeSphere(float radius, float amplitude) :
+m_radius(radius),
+m_amplitude(amplitude),
+m_indexbuffer(NULL),
+m_pending_selection_new(false),
+m_shader_id(-1),
+m_campos_slot(SHADER_NO_SLOT),
+m_morph_start_slot(SHADER_NO_SLOT),
+m_morph_end_slot(SHADER_NO_SLOT)
+{
+	// The deepest level of quads that are still larger than CUBESPHERE_MIN_QUAD
+	double quads_per_edge = m_radius * M_PI / 2 / CUBESPHERE_MIN_QUAD;
+	int maxdepth = floor(log2(quads_per_edge / CUBESPHERE_PATCH_SIZE));
+	m_maxdepth = std::max(0, std::min(maxdepth, CUBESPHERE_MAX_DEPTH));
+
+	m_campos[0] = m_campos[1] = m_campos[2] = 0;
+	std::fill(m_lodranges, m_lodranges + CUBESPHERE_MAX_DEPTH + 1, 0);
+
+	buildIndices();
+}
+
+/// Deletes all buffers, must be called while the OpenGL context is current
+CubeSphere::~CubeSphere()
+{
+	for (auto &buffer : m_buffers)
+		delete buffer.second;
+
+	for (auto &mesh : m_pending_uploads)
+		delete[] mesh.vertices;
+
+	delete m_indexbuffer;
+}
+
+/**
+ * \brief Calculates the distances below which the nodes of each depth are subdivided
+ *
+ * A node is drawn as a patch of CUBESPHERE_PATCH_SIZE^2 quads. Its geometric error is the
+ * terrain (up to m_amplitude per unit of the quad size) and the curvature of the sphere that
+ * the quads flatten, both of which its children reduce by half.
+ */
+void CubeSphere::updateLodRanges()
+{
+	LodManager *lod = game->getLodManager();
+
+	for (uint8_t depth = 0; depth <= m_maxdepth; depth++)
+	{
+		double nodesize = m_radius * M_PI / 2 / (1 << depth);
+		double quadsize = nodesize / CUBESPHERE_PATCH_SIZE;
+		double error = quadsize * m_amplitude + quadsize * quadsize / (8 * m_radius);
+
+		m_lodranges[depth] = std::max(lod->getLodDistance(error),
+			CUBESPHERE_LOD_RANGE_MIN * nodesize);
+	}
+}
+
+/**
+ * \brief Generates the triangle indices shared by all patches, one variant per stitch combination
+ *
+ * On a stitched edge, every odd vertex is replaced by its even predecessor. Triangles that
+ * thereby become degenerate are left out, the others fan out to the remaining vertices.
+ */
+void CubeSphere::buildIndices()
+{
+	const int n = CUBESPHERE_PATCH_SIZE;
+
+	for (uint8_t stitch = 0; stitch < CUBESPHERE_STITCH_VARIANTS; stitch++)
+	{
+		auto remap = [stitch, n](int i, int j) -> GLushort
+		{
+			if (i % 2 == 1 && ((j == 0 && (stitch & STITCH_SOUTH))
+					|| (j == n && (stitch & STITCH_NORTH)))) i--;
+			if (j % 2 == 1 && ((i == 0 && (stitch & STITCH_WEST))
+					|| (i == n && (stitch & STITCH_EAST)))) j--;
+			return PATCH_VERTEX(i, j);
+		};
+
+		m_variant_first[stitch] = m_indices.size();
+
+		for (int j = 0; j < n; j++)
+		for (int i = 0; i < n; i++)
+		{
+			GLushort tris[6] = {
+				remap(i, j), remap(i + 1, j), remap(i + 1, j + 1),
+				remap(i, j), remap(i + 1, j + 1), remap(i, j + 1)
+			};
+
+			for (int t = 0; t < 6; t += 3)
+			{
+				if (tris[t] == tris[t + 1] || tris[t + 1] == tris[t + 2]
+						|| tris[t] == tris[t + 2]) continue;
+				m_indices.insert(m_indices.end(), tris + t, tris + t + 3);
+			}
+		}
+
+		m_variant_count[stitch] = m_indices.size() - m_variant_first[stitch];
+	}
+}
+
+/**
+ * \brief Selects the quadtree nodes to draw for the given camera position
+ * \param campos_relative The camera position relative to the center, in the rotation of the sphere
+ *
+ * A node is subdivided while the camera is within its LOD range (see updateLodRanges) of its
+ * bounding sphere. Nodes behind the horizon are skipped entirely, taking the terrain height
+ * into account.
+ */
+void CubeSphere::selectPatches(SimpleVec3d campos_relative)
+{
+	updateLodRanges();
+
+	m_selection.clear();
+	m_selected_keys.clear();
+	m_traverse_stack.clear();
+
+	double camdist = getVectorLength(campos_relative);
+	double rmin = m_radius * (1 - m_amplitude);
+	double rmax = m_radius * (1 + m_amplitude);
+
+	// Nodes further away than this angle from the camera direction are hidden by the horizon
+	bool horizon_cull = camdist > rmin;
+	double horizon = horizon_cull ? acos(rmin / camdist) + acos(rmin / rmax) : M_PI;
+	SimpleVec3d camdir = horizon_cull ? campos_relative / camdist : SimpleVec3d(0, 0, 1);
+
+	for (uint8_t face = 0; face < 6; face++)
+		m_traverse_stack.push_back(makeKey(face, 0, 0, 0));
+
+	while (!m_traverse_stack.empty())
+	{
+		uint64_t key = m_traverse_stack.back();
+		m_traverse_stack.pop_back();
+
+		uint8_t face = KEY_FACE(key), depth = KEY_DEPTH(key);
+		double size = 2.0 / (1 << depth);
+		double u0 = -1 + KEY_X(key) * size;
+		double v0 = -1 + KEY_Y(key) * size;
+
+		// Bounding sphere of the node, the corners and edge centers are the furthest points
+		SimpleVec3d center = spherify(facePoint(face, u0 + size / 2, v0 + size / 2));
+		double angle_radius = 0, radius = 0;
+		for (int k = 0; k < 8; k++)
+		{
+			static const double offs[8][2] = {
+				{ 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 },
+				{ 0.5, 0 }, { 1, 0.5 }, { 0.5, 1 }, { 0, 0.5 }
+			};
+			SimpleVec3d p = spherify(facePoint(face, u0 + offs[k][0] * size,
+				v0 + offs[k][1] * size));
+			angle_radius = std::max(angle_radius, angleBetween(center, p));
+			radius = std::max(radius, getVectorLength(p - center));
+		}
+
+		if (horizon_cull && angleBetween(camdir, center) - angle_radius > horizon)
+			continue;
+
+		// The terrain height is only known to the shader, the LOD uses the undisplaced surface
+		double dist = getVectorLength(campos_relative - center * m_radius) - radius * m_radius;
+
+		if (depth < m_maxdepth && dist < m_lodranges[depth])
+		{
+			uint32_t x = KEY_X(key) * 2, y = KEY_Y(key) * 2;
+			m_traverse_stack.push_back(makeKey(face, depth + 1, x,     y    ));
+			m_traverse_stack.push_back(makeKey(face, depth + 1, x + 1, y    ));
+			m_traverse_stack.push_back(makeKey(face, depth + 1, x,     y + 1));
+			m_traverse_stack.push_back(makeKey(face, depth + 1, x + 1, y + 1));
+			continue;
+		}
+
+		// Leaf: appears at the range of the parent and morphs into it before that
+		CubeSpherePatch patch;
+		patch.key = key;
+		patch.stitch = 0;
+		patch.morph_end   = (depth == 0) ? 0 : m_lodranges[depth - 1];
+		patch.morph_start = patch.morph_end * CUBESPHERE_MORPH_START;
+
+		m_selection.push_back(patch);
+		m_selected_keys.insert(key);
+	}
+
+	for (auto &patch : m_selection)
+		patch.stitch = getStitch(patch.key);
+}
+
+/**
+ * \brief Finds out which edges of a selected patch border a coarser selected patch
+ * \param key The key of the patch, m_selected_keys must be up to date
+ *
+ * Samples a point just outside of each edge center, also across cube faces, and looks
+ * for a selected ancestor of that point.
+ */
+uint8_t CubeSphere::getStitch(uint64_t key)
+{
+	uint8_t face = KEY_FACE(key), depth = KEY_DEPTH(key);
+	if (depth == 0) return 0;
+
+	double size = 2.0 / (1 << depth);
+	double u0 = -1 + KEY_X(key) * size;
+	double v0 = -1 + KEY_Y(key) * size;
+	double eps = size / 4;
+
+	const struct { uint8_t edge; double u, v; } samples[4] =
+	{
+		{ STITCH_SOUTH,	u0 + size / 2,		v0 - eps		},
+		{ STITCH_EAST,	u0 + size + eps,	v0 + size / 2		},
+		{ STITCH_NORTH,	u0 + size / 2,		v0 + size + eps		},
+		{ STITCH_WEST,	u0 - eps,		v0 + size / 2		}
+	};
+
+	uint8_t stitch = 0;
+	for (auto &s : samples)
+	{
+		uint8_t nface;
+		double nu, nv;
+		cubeToFace(facePoint(face, s.u, s.v), &nface, &nu, &nv);
+
+		for (int d = depth - 1; d >= 0; d--)
+		{
+			uint32_t cells = 1 << d;
+			uint32_t x = std::min(cells - 1, (uint32_t)std::max(0.0, (nu + 1) / 2 * cells));
+			uint32_t y = std::min(cells - 1, (uint32_t)std::max(0.0, (nv + 1) / 2 * cells));
+
+			if (m_selected_keys.count(makeKey(nface, d, x, y)))
+			{
+				stitch |= s.edge;
+				break;
+			}
+		}
+	}
+
+	return stitch;
+}
+
+/**
+ * \brief Generates positions and morph targets of all vertices of a patch
+ * \param key The key of the patch
+ *
+ * The morph target of a vertex is its position on the grid of the parent level, which has
+ * half the resolution: odd vertices are moved to the center of the parent edge they lie on.
+ * Returns a new[] array of (CUBESPHERE_PATCH_SIZE + 1)^2 vertices.
+ */
+GLfloat *CubeSphere::buildPatchVertices(uint64_t key)
+{
+	const int n = CUBESPHERE_PATCH_SIZE;
+	uint8_t face = KEY_FACE(key), depth = KEY_DEPTH(key);
+	double size = 2.0 / (1 << depth);
+	double u0 = -1 + KEY_X(key) * size;
+	double v0 = -1 + KEY_Y(key) * size;
+
+	std::vector<SimpleVec3d> pos((n + 1) * (n + 1));
+	for (int j = 0; j <= n; j++)
+	for (int i = 0; i <= n; i++)
+	{
+		SimpleVec3d c = facePoint(face, u0 + size * i / n, v0 + size * j / n);
+		pos[PATCH_VERTEX(i, j)] = spherify(c) * m_radius;
+	}
+
+	GLfloat *vertices = new GLfloat[(n + 1) * (n + 1) * PATCH_VERTEX_FLOATS];
+	for (int j = 0; j <= n; j++)
+	for (int i = 0; i <= n; i++)
+	{
+		SimpleVec3d p = pos[PATCH_VERTEX(i, j)];
+		SimpleVec3d m = p;
+
+		// Diagonals of the parent quads go from (i, j) to (i + 1, j + 1), see buildIndices
+		if (i % 2 == 1 && j % 2 == 1)
+			m = (pos[PATCH_VERTEX(i - 1, j - 1)] + pos[PATCH_VERTEX(i + 1, j + 1)]) / 2;
+		else if (i % 2 == 1)
+			m = (pos[PATCH_VERTEX(i - 1, j)] + pos[PATCH_VERTEX(i + 1, j)]) / 2;
+		else if (j % 2 == 1)
+			m = (pos[PATCH_VERTEX(i, j - 1)] + pos[PATCH_VERTEX(i, j + 1)]) / 2;
+
+		GLfloat *v = vertices + PATCH_VERTEX(i, j) * PATCH_VERTEX_FLOATS;
+		v[0] = p.x; v[1] = p.y; v[2] = p.z;
+		v[3] = m.x; v[4] = m.y; v[5] = m.z;
+	}
+
+	return vertices;
+}
+
+/**
+ * \brief Updates the selection of patches and builds the vertices of new ones
+ * \param campos_relative The camera position relative to the center, in the rotation of the sphere
+ *
+ * Supposed to be called by a background thread (see Planet::updateDetailThread), makes no
+ * OpenGL calls. The results are handed over to render(), which uploads them. Returns true if
+ * the selection has changed.
+ */
+bool CubeSphere::update(SimpleVec3d campos_relative)
+{
+	std::unordered_set<uint64_t> previous_keys;
+	previous_keys.swap(m_selected_keys);
+
+	selectPatches(campos_relative);
+	if (m_selected_keys == previous_keys) return false;
+
+	std::vector<CubeSpherePatchMesh> uploads;
+	for (auto &patch : m_selection)
+	{
+		if (m_resident.count(patch.key)) continue;
+		CubeSpherePatchMesh mesh = { patch.key, buildPatchVertices(patch.key) };
+		uploads.push_back(mesh);
+		m_resident.insert(patch.key);
+	}
+
+	std::vector<uint64_t> evictions;
+	for (auto it = m_resident.begin(); it != m_resident.end();)
+	{
+		if (m_selected_keys.count(*it))
+		{
+			++it;
+			continue;
+		}
+		evictions.push_back(*it);
+		it = m_resident.erase(it);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	/*
+		render() may not have picked up the last handover yet: An eviction cancels a
+		pending upload of the same patch and vice versa, render() applies the
+		evictions before the uploads.
+	*/
+	for (uint64_t key : evictions)
+	{
+		auto pending = std::find_if(m_pending_uploads.begin(), m_pending_uploads.end(),
+			[key](const CubeSpherePatchMesh &m) { return m.key == key; });
+		if (pending != m_pending_uploads.end())
+		{
+			delete[] pending->vertices;
+			m_pending_uploads.erase(pending);
+		}
+		m_pending_evictions.push_back(key);
+	}
+
+	for (auto &mesh : uploads)
+	{
+		m_pending_evictions.erase(std::remove(m_pending_evictions.begin(),
+			m_pending_evictions.end(), mesh.key), m_pending_evictions.end());
+		m_pending_uploads.push_back(mesh);
+	}
+
+	m_pending_selection = m_selection;
+	m_pending_selection_new = true;
+
+	return true;
+}
+
+/**
+ * \brief Applies the last handover of update() and uploads new patches to GPU memory
+ *
+ * Must be called from the thread that owns the OpenGL context. If the LOD thread is just
+ * handing over new patches, they are picked up in the next frame instead of waiting.
+ */
+void CubeSphere::uploadPending()
+{
+	if (m_indexbuffer == NULL)
+	{
+		m_indexbuffer = new MeshBuffer(MESH_MORPH);
+		m_indexbuffer->uploadIndices(&m_indices[0], m_indices.size(), GL_UNSIGNED_SHORT);
+	}
+
+	if (!m_mutex.try_lock()) return;
+
+	if (!m_pending_selection_new)
+	{
+		m_mutex.unlock();
+		return;
+	}
+
+	for (uint64_t key : m_pending_evictions)
+	{
+		auto buffer = m_buffers.find(key);
+		if (buffer == m_buffers.end()) continue;
+		delete buffer->second;
+		m_buffers.erase(buffer);
+	}
+
+	for (auto &mesh : m_pending_uploads)
+	{
+		MeshBuffer *&buffer = m_buffers[mesh.key];
+		if (buffer == NULL) buffer = new MeshBuffer(MESH_MORPH);
+		buffer->uploadVertices(mesh.vertices,
+			(CUBESPHERE_PATCH_SIZE + 1) * (CUBESPHERE_PATCH_SIZE + 1));
+		delete[] mesh.vertices;
+	}
+
+	m_drawn.swap(m_pending_selection);
+	m_pending_uploads.clear();
+	m_pending_evictions.clear();
+	m_pending_selection_new = false;
+
+	m_mutex.unlock();
+}
+
+/**
+ * \brief Draws all selected patches with the given shader
+ * \param campos_relative The camera position relative to the center, in the rotation of the sphere
+ * \param shader The shader, which must call morphVertex() (see builtin.glsl)
+ *
+ * Like SphereFraction, this is supposed to be called by the object that owns the CubeSphere.
+ */
+void CubeSphere::render(SimpleVec3d campos_relative, ShaderHandle &shader)
+{
+	uploadPending();
+
+	shader.resolve();
+	if (shader.getID() != m_shader_id)
+	{
+		m_shader_id = shader.getID();
+		m_campos_slot = shader->getUniformSlot("morph_campos");
+		m_morph_start_slot = shader->getUniformSlot("morph_start");
+		m_morph_end_slot = shader->getUniformSlot("morph_end");
+	}
+
+	m_campos[0] = campos_relative.x;
+	m_campos[1] = campos_relative.y;
+	m_campos[2] = campos_relative.z;
+
+	GLenum mode = game->getWireframe() ? GL_LINE_STRIP : GL_TRIANGLES;
+
+	for (auto &patch : m_drawn)
+	{
+		auto buffer = m_buffers.find(patch.key);
+		if (buffer == m_buffers.end()) continue;
+
+		shader->setUniform3f(m_campos_slot, m_campos);
+		shader->setUniformf(m_morph_start_slot, patch.morph_start);
+		shader->setUniformf(m_morph_end_slot, patch.morph_end);
+		shader.request();
+
+		buffer->second->renderRange(mode, m_variant_first[patch.stitch],
+			m_variant_count[patch.stitch], m_indexbuffer);
+	}
+}
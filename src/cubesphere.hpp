@@ -0,0 +1,137 @@
+#include <unordered_set>
+#include <unordered_map>
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <mutex>
+
+#include "gllibs.hpp"
+#include "util.hpp"
+
+#ifndef _CUBESPHERE_H
+#define _CUBESPHERE_H
+
+class MeshBuffer;
+class ShaderHandle;
+
+// Number of quads along the edge of every CubeSphere patch, must be even
+#define CUBESPHERE_PATCH_SIZE 16
+
+// Deepest quadtree level, limited by the 28 bits for x and y in the patch key
+#define CUBESPHERE_MAX_DEPTH 14
+
+// Number of stitch variants: every combination of the four cubesphere_stitch edges
+#define CUBESPHERE_STITCH_VARIANTS 16
+
+/**
+ * \brief Edges of a patch that border a coarser patch
+ *
+ * Every second vertex on these edges is left out, so that the edge matches the coarser
+ * neighbour exactly (no T-junction cracks).
+ */
+enum cubesphere_stitch
+{
+	STITCH_SOUTH = 1 << 0,	/** v = min */
+	STITCH_EAST  = 1 << 1,	/** u = max */
+	STITCH_NORTH = 1 << 2,	/** v = max */
+	STITCH_WEST  = 1 << 3	/** u = min */
+};
+
+/// A quadtree node of a CubeSphere that has been selected for drawing
+struct CubeSpherePatch
+{
+	uint64_t key;		// face, depth and position in the quadtree
+	uint8_t stitch;		// combination of cubesphere_stitch
+	float morph_start;	// distance at which morphing to the parent level begins
+	float morph_end;	// distance at which the patch looks exactly like its parent
+};
+
+/// Vertices of a patch that have been built by update(), but not uploaded by render()
+struct CubeSpherePatchMesh
+{
+	uint64_t key;
+	GLfloat *vertices;
+};
+
+/**
+ * \brief Planet surface made of six quadtrees on the faces of a cube, projected onto a sphere
+ *
+ * Every selected quadtree node is drawn as a patch of CUBESPHERE_PATCH_SIZE^2 quads, so the
+ * vertex density only depends on the distance to the camera and not on the latitude. Patches
+ * share one index buffer that contains a variant for every combination of stitched edges.
+ * Between the distances at which a patch appears and disappears, its vertices are morphed
+ * towards the parent level by morphVertex() in the vertex shader (see builtin.glsl).
+ */
+class CubeSphere
+{
+	public:
+		CubeSphere(float radius, float amplitude);
+		~CubeSphere();
+
+		bool update(SimpleVec3d campos_relative);
+		void render(SimpleVec3d campos_relative, ShaderHandle &shader);
+
+		/// Number of vertices of the patches selected by the last update(), LOD thread only
+		uint32_t getVertexNum()
+			{ return m_selection.size() * (CUBESPHERE_PATCH_SIZE + 1) * (CUBESPHERE_PATCH_SIZE + 1); }
+
+	private:
+		void buildIndices();
+		void selectPatches(SimpleVec3d campos_relative);
+		uint8_t getStitch(uint64_t key);
+		GLfloat *buildPatchVertices(uint64_t key);
+		void uploadPending();
+
+		void updateLodRanges();
+
+		float m_radius;
+		float m_amplitude;
+		uint8_t m_maxdepth;
+		float m_lodranges[CUBESPHERE_MAX_DEPTH + 1];
+
+		/*
+			Shared indices for all patches: m_indices contains all stitch variants,
+			variant n starts at m_variant_first[n] and consists of m_variant_count[n]
+			indices; uploaded to m_indexbuffer by the first render() call
+		*/
+		std::vector<GLushort> m_indices;
+		uint32_t m_variant_first[CUBESPHERE_STITCH_VARIANTS];
+		uint32_t m_variant_count[CUBESPHERE_STITCH_VARIANTS];
+		MeshBuffer *m_indexbuffer;
+
+		/*
+			Only used by update() (LOD thread): the current selection, the set of its
+			keys, the keys of all patches whose vertices have been handed over to
+			render() and the stack for traversing the quadtrees
+		*/
+		std::vector<CubeSpherePatch> m_selection;
+		std::unordered_set<uint64_t> m_selected_keys;
+		std::unordered_set<uint64_t> m_resident;
+		std::vector<uint64_t> m_traverse_stack;
+
+		/*
+			Handover from update() to render(), protected by m_mutex: new patch
+			vertices, keys of patches that are not needed anymore and the new
+			selection (if m_pending_selection_new is true)
+		*/
+		std::vector<CubeSpherePatchMesh> m_pending_uploads;
+		std::vector<uint64_t> m_pending_evictions;
+		std::vector<CubeSpherePatch> m_pending_selection;
+		bool m_pending_selection_new;
+		std::mutex m_mutex;
+
+		/*
+			Only used by render(): the patches to draw and their vertex buffers
+		*/
+		std::vector<CubeSpherePatch> m_drawn;
+		std::unordered_map<uint64_t, MeshBuffer *> m_buffers;
+		GLfloat m_campos[3];
+
+		// Uniform slots of the morphVertex() parameters in the shader with ID m_shader_id
+		int16_t m_shader_id;
+		int16_t m_campos_slot;
+		int16_t m_morph_start_slot;
+		int16_t m_morph_end_slot;
+};
+
+#endif
@@ -1,23 +1,109 @@
+#include <unordered_map>
+#include <algorithm>
 #include "gllibs.hpp"
 #include <ctime>
 
 #include "drawutil.hpp"
 #include "gamevars.hpp"
+#include "glstate.hpp"
+#include "mesh.hpp"
 #include "config.hpp"
 #include "debug.hpp"
 #include "game.hpp"
 #include "util.hpp"
+#include "lod.hpp"
 
 
 // Less recursion results in better performance in comparison to quadtrees
 #define CHILDREN_NUM 4
 
-#define VERTEX_NO_EXIST 0xffff
+// Vertices closer than this (100m IRL) are welded into one; slight differences occur
+// during the calculations, although the vertices are displayed the same
+#define WELD_DISTANCE (USC * 0.1)
+
+// For large spheres, float rounding in the trigonometry exceeds WELD_DISTANCE (e.g. at
+// azimuth 0 and 2*PI), so the distance also scales with the radius
+#define WELD_DISTANCE_RELATIVE 0.000001
+
+// Patch layout, see SphereFraction::buildPatches
+#define SPHEREPATCH_ROWS_MAX 8
+#define SPHEREPATCH_CELLS_MIN 4
 
 /*
 	Helpers:
 */
 
+/// Cell of the hash grid that is used to weld vertices in SphereFraction::updateVertices
+struct WeldCell
+{
+	int32_t x, y, z;
+
+	bool operator==(const WeldCell &other) const
+		{ return x == other.x && y == other.y && z == other.z; }
+};
+
+struct WeldCellHash
+{
+	size_t operator()(const WeldCell &c) const
+		{ return (c.x * 73856093u) ^ (c.y * 19349663u) ^ (c.z * 83492791u); }
+};
+
+typedef std::unordered_map<WeldCell, GLuint, WeldCellHash> WeldGrid;
+
+/**
+ * \brief Returns the index of the given vertex, adds it to the vertex array if it is new
+ * \param grid Hash grid of the quantized positions of all vertices added so far
+ * \param distance Vertices closer than this are welded
+ * \param vertices Vertex array (3 floats per vertex)
+ * \param vertexnum Number of vertices in the array, incremented if the vertex is added
+ * \param vertex The position to look up
+ *
+ * Grid cells are twice as large as distance, so that all vertices a vertex may be
+ * welded with are in the 2x2x2 cells on the side of the vertex's position in its cell.
+ */
+static GLuint weldVertex(WeldGrid &grid, float distance, GLfloat *vertices, GLuint *vertexnum,
+		SimpleVec3d vertex)
+{
+	double qx = vertex.x / (distance * 2);
+	double qy = vertex.y / (distance * 2);
+	double qz = vertex.z / (distance * 2);
+
+	WeldCell cell = { (int32_t)floor(qx), (int32_t)floor(qy), (int32_t)floor(qz) };
+
+	// Direction of the neighbouring cells that may contain vertices within WELD_DISTANCE
+	int32_t dx = (qx - cell.x < 0.5) ? -1 : 1;
+	int32_t dy = (qy - cell.y < 0.5) ? -1 : 1;
+	int32_t dz = (qz - cell.z < 0.5) ? -1 : 1;
+
+	for (uint8_t n = 0; n < 8; n++)
+	{
+		WeldCell neighbour = { cell.x + ((n & 1) ? dx : 0), cell.y + ((n & 2) ? dy : 0),
+			cell.z + ((n & 4) ? dz : 0) };
+
+		auto found = grid.find(neighbour);
+		if (found == grid.end()) continue;
+
+		GLfloat *other = &vertices[found->second * 3];
+		if	(   almostEqual(other[0], vertex.x, distance)
+			 && almostEqual(other[1], vertex.y, distance)
+			 && almostEqual(other[2], vertex.z, distance))
+		{
+			return found->second;
+		}
+	}
+
+	GLuint id = (*vertexnum)++;
+	vertices[id * 3    ] = vertex.x;
+	vertices[id * 3 + 1] = vertex.y;
+	vertices[id * 3 + 2] = vertex.z;
+
+	// If the cell is already occupied, the new vertex can't be found, but the
+	// spacing of the sphere grid is orders of magnitude larger than a cell
+	grid.emplace(cell, id);
+
+	return id;
+}
+
 /**
  * \brief Creates a new Image2d with file as picture
  * \param file The file to use as texture
@@ -30,7 +116,7 @@ Image2d::Image2d(std::string file)
 /// Deletes OpenGL reference to texture
 Image2d::~Image2d()
 {
-	glDeleteTextures(1, &m_img);
+	GLState::deleteTextures(1, &m_img);
 }
 
 /**
@@ -56,6 +142,7 @@ void Image2d::init(std::string file)
 {
 	m_img = SOIL_load_OGL_texture (texPath(file).c_str(), SOIL_LOAD_RGBA,
 		SOIL_CREATE_NEW_ID, SOIL_FLAG_NTSC_SAFE_RGB);
+	GLState::forgetTexture();
 
 	// Z - always 1.0
 	m_vertices[0][2] = 1.0;
@@ -106,9 +193,9 @@ void Image2d::setBounds(float x, float y, float w, float h)
 
 void Image2d::render()
 {
-	glEnable(GL_TEXTURE_2D);
+	GLState::enable(GL_TEXTURE_2D);
 
-	glBindTexture(GL_TEXTURE_2D, m_img);
+	GLState::bindTexture(m_img);
 
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
@@ -121,7 +208,7 @@ void Image2d::render()
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_VERTEX_ARRAY);
 
-	glDisable(GL_TEXTURE_2D);
+	GLState::disable(GL_TEXTURE_2D);
 }
 
 void makeCuboid(SimpleVec3d c1, SimpleVec3d c2, int detailx, int detaily, int detailz)
@@ -194,6 +281,7 @@ void makeCylinder(float radius, float zheight, float detail)
 			gluDisk(qobj, 0, radius, detail, detail);
 		}
 		glPopMatrix();
+		gluDeleteQuadric(qobj);
 	}
 	glPopMatrix();
 }
@@ -263,55 +351,130 @@ inline void cuboidSide(SimpleVec3d vec1, SimpleVec3d vec2, int detailx, int deta
 	Procedural generation sphere = SphereFraction's
 */
 
-/// Creates a new, yet empty SphereFraction
-SphereFraction::SphereFraction() :
-m_vertices_id(-1),
-m_children_static(false)
+/// Removes all nodes, but keeps the allocated storage
+void SphereNodePool::clear()
 {
-	// empty constructor for initialization
-	m_children.clear();
+	inc_min.clear();
+	inc_max.clear();
+	azi_min.clear();
+	azi_max.clear();
+	fracsize.clear();
+	first_child.clear();
+	child_rows.clear();
+	child_cols.clear();
 }
 
-/// Also deletes all children recursively
-SphereFraction::~SphereFraction()
+/**
+ * \brief Appends a new leaf node
+ * \param radius The radius of the sphere
+ * \param incmin Inclination of corners 0 and 1
+ * \param incmax Inclination of corners 2 and 3
+ * \param azimin Azimuth of corners 0 and 2
+ * \param azimax Azimuth of corners 1 and 3
+ * \return The index of the new node
+ */
+uint32_t SphereNodePool::push(float radius, float incmin, float incmax, float azimin, float azimax)
 {
-	for (auto row : m_children)
-	for (auto child : row)
-		delete child.second;
+	SphericalVector3f diffvector_spherical(radius, incmin - incmax + PI / 2, 0);
 
-	m_children.clear();
+	SimpleVec3d diffvector = SimpleVec3d(SphericalVector3f(radius, PI / 2, 0))
+		- SimpleVec3d(diffvector_spherical);
+
+	inc_min.push_back(incmin);
+	inc_max.push_back(incmax);
+	azi_min.push_back(azimin);
+	azi_max.push_back(azimax);
+	fracsize.push_back(getVectorLength(diffvector));
+	first_child.push_back(SPHERENODE_NO_CHILDREN);
+	child_rows.push_back(0);
+	child_cols.push_back(0);
+
+	return size() - 1;
+}
 
-	if (m_vertices_id != -1)
+/**
+ * \brief Appends a leaf node with the same bounds as a node of another pool
+ * \param from The pool to copy from
+ * \param node The index of the node in from
+ * \return The index of the new node
+ */
+uint32_t SphereNodePool::copy(SphereNodePool &from, uint32_t node)
+{
+	inc_min.push_back(from.inc_min[node]);
+	inc_max.push_back(from.inc_max[node]);
+	azi_min.push_back(from.azi_min[node]);
+	azi_max.push_back(from.azi_max[node]);
+	fracsize.push_back(from.fracsize[node]);
+	first_child.push_back(SPHERENODE_NO_CHILDREN);
+	child_rows.push_back(0);
+	child_cols.push_back(0);
+
+	return size() - 1;
+}
+
+/**
+ * \brief Subdivides a leaf node by appending its children to the end of the pool
+ * \param node The index of the node
+ * \param radius The radius of the sphere
+ * \param yawres Number of columns
+ * \param pitchres Number of rows
+ */
+void SphereNodePool::addChildren(uint32_t node, float radius, int yawres, int pitchres)
+{
+	if (yawres == 0 || pitchres == 0) return;
+
+	// push_back may reallocate, so don't keep references to the parent's bounds
+	float incmin = inc_min[node];
+	float incmax = inc_max[node];
+	float azimin = azi_min[node];
+	float azimax = azi_max[node];
+
+	first_child[node] = size();
+	child_rows[node] = pitchres;
+	child_cols[node] = yawres;
+
+	// exactly pitchres rows of yawres children each
+	for (int pitchn = 0; pitchn < pitchres; pitchn++)
 	{
-		free(m_quadvertices[m_vertices_id]);
-		//free(m_quadnormals[[m_vertices_id]);
-		free(m_quadindices[m_vertices_id]);
+		float inc1 = incmin + (incmax - incmin) * pitchn / pitchres;
+		float inc2 = incmin + (incmax - incmin) * (pitchn + 1) / pitchres;
+
+		for (int yawn = 0; yawn < yawres; yawn++)
+		{
+			float azi1 = azimin + (azimax - azimin) * yawn / yawres;
+			float azi2 = azimin + (azimax - azimin) * (yawn + 1) / yawres;
+
+			push(radius, inc1, inc2, azi1, azi2);
+		}
 	}
 }
 
 /**
- * \brief Creates a new SphereFraction
+ * \brief Creates a new SphereFraction without children
  * \param p The bounds of the new SphereFraction
- *
- * Only to be used to created children SphereFractions.
  */
 SphereFraction::SphereFraction(SphericalVector3f *p) :
-m_vertices_id(-1),
+m_radius(p[0].radius),
+m_meshstats(),
 m_children_static(false)
 {
-	m_children.clear();
-
-	for (uint8_t i = 0; i < 4; i++)
-		m_positions[i] = p[i];
-
-	SphericalVector3f diffvector_spherical(m_positions[0].radius,
-		m_positions[1].inclination - m_positions[3].inclination + PI / 2,
-		m_positions[1].azimuth - m_positions[3].azimuth);
+	m_nodes.push(m_radius, p[0].inclination, p[3].inclination, p[0].azimuth, p[3].azimuth);
+	buildPatches();
+}
 
-	SimpleVec3d diffvector = SimpleVec3d(SphericalVector3f(m_positions[0].radius, PI / 2, 0))
-		- SimpleVec3d(diffvector_spherical); 
+SphereFraction::~SphereFraction()
+{
+	for (auto &mesh : m_pending)
+	{
+		free(mesh.vertices);
+		free(mesh.indices);
+	}
 
-	m_fracsize = getVectorLength(diffvector);
+	for (auto &patch : m_patchbuffers)
+	{
+		delete patch.buffers[0];
+		delete patch.buffers[1];
+	}
 }
 
 /**
@@ -338,275 +501,406 @@ SphereFraction *SphereFraction::makePrototype(float radius, float dyaw, float dp
 	return sphere;
 }
 
-/// Helper function that find out if a vertex is already included in a list of vertices
-inline uint32_t SphereFraction::vertexExistsAlready(GLfloat *vertices, GLuint vertexnum, SimpleVec3d vertex)
+/**
+ * \brief Divides the children of the outermost node into patches, all of them are dirty
+ *
+ * There are at most SPHEREPATCH_ROWS_MAX x SPHEREPATCH_ROWS_MAX patches, and every patch
+ * contains at least SPHEREPATCH_CELLS_MIN rows and columns, if there are enough children.
+ */
+void SphereFraction::buildPatches()
 {
-	if (vertexnum <= CHILDREN_NUM) return VERTEX_NO_EXIST;
+	m_patches.clear();
+	m_rootchild_patch.clear();
 
-	for (uint32_t i = vertexnum - CHILDREN_NUM; i <= vertexnum; i++)
+	SpherePatch patch;
+	patch.dirty = true;
+	patch.stats = SphereMeshStats();
+
+	if (!containsChildren())
 	{
-		// if the vectors are very close to each other (less than 100m IRL) they
-		// are likely the same, so do not add another vector; slight differences
-		// in vectors occur during the calculations, athough they are displayed the same
-		if	(   almostEqual(vertices[i*3  ], vertex.x, USC * 0.1)
-			 && almostEqual(vertices[i*3+1], vertex.y, USC * 0.1)
-			 && almostEqual(vertices[i*3+2], vertex.z, USC * 0.1))
-		{
-			return i;
-		}
+		patch.nodes.push_back(0);
+		m_patches.push_back(patch);
+		return;
 	}
 
-	return VERTEX_NO_EXIST;
-}
+	uint32_t first = m_nodes.first_child[0];
+	uint32_t rows = m_nodes.child_rows[0];
+	uint32_t cols = m_nodes.child_cols[0];
 
-/// Insert a vertex into a list of vertices that make up the SphereFraction
-inline void SphereFraction::arrayInsertVector(int i, int *vid, GLfloat *m_quadvertices,
-		GLuint *m_quadindices, SimpleVec3d vertex)
-{
-	uint32_t vertexnum = vertexExistsAlready(m_quadvertices, *vid, vertex);
+	uint32_t prows = std::min<uint32_t>(SPHEREPATCH_ROWS_MAX,
+		(rows + SPHEREPATCH_CELLS_MIN - 1) / SPHEREPATCH_CELLS_MIN);
+	uint32_t pcols = std::min<uint32_t>(SPHEREPATCH_ROWS_MAX,
+		(cols + SPHEREPATCH_CELLS_MIN - 1) / SPHEREPATCH_CELLS_MIN);
 
-	if (vertexnum == VERTEX_NO_EXIST)
-	{
-		m_quadindices [i       ] = *vid;
-		m_quadvertices[*vid*3  ] = vertex.x;
-		m_quadvertices[*vid*3+1] = vertex.y;
-		m_quadvertices[*vid*3+2] = vertex.z;
-		(*vid)++;
-	}
-	else
+	m_patches.assign(prows * pcols, patch);
+
+	for (uint32_t row = 0; row < rows; row++)
+	for (uint32_t col = 0; col < cols; col++)
 	{
-		m_quadindices[i] = vertexnum;
+		uint32_t patchid = (row * prows / rows) * pcols + col * pcols / cols;
+		m_patches[patchid].nodes.push_back(first + row * cols + col);
+		m_rootchild_patch.push_back(patchid);
 	}
 }
 
 /**
- * \brief Updates the vertices and indices arrays
- *
- * Only to be called for the outermost SphereFraction
+ * \brief Builds the vertices and indices arrays of a single patch
+ * \param patch The patch, its stats are updated
+ * \param mesh Receives the newly allocated arrays
  */
-void SphereFraction::updateVertices()
+void SphereFraction::buildPatchMesh(SpherePatch &patch, SpherePatchMesh &mesh)
 {
-	std::vector<std::map<int, SimpleVec3d *>> unprocessed_vert = getVertices();
+	// Collect the leaves below the patch's nodes, only they are drawn
+	m_patch_leaves.clear();
+	m_traverse_stack.assign(patch.nodes.begin(), patch.nodes.end());
+
+	while (!m_traverse_stack.empty())
+	{
+		uint32_t node = m_traverse_stack.back();
+		m_traverse_stack.pop_back();
 
-	size_t size = 0;
-	for (auto &row : unprocessed_vert)
-		size += row.size() * 4; // *4 for 4 vertices per QUAD
+		uint32_t first = m_nodes.first_child[node];
+		if (first == SPHERENODE_NO_CHILDREN)
+		{
+			m_patch_leaves.push_back(node);
+			continue;
+		}
+
+		uint32_t count = m_nodes.child_rows[node] * m_nodes.child_cols[node];
+		for (uint32_t child = first; child < first + count; child++)
+			m_traverse_stack.push_back(child);
+	}
 
-	int8_t vertices_id;
-	if (m_vertices_id == 1)	vertices_id = 0;
-	else			vertices_id = 1;
+	size_t size = m_patch_leaves.size() * 4; // *4 for 4 vertices per QUAD
 
 	/*
-		Generate vertex, normal, index buffer for OpenGL (*3 = 3 Dimensions)
-		divide by 2 as every second index just points to a already saved
-		vertex
+		Generate vertex and index buffer for OpenGL (*3 = 3 Dimensions). All quads
+		are welded in a hash grid, so the vertex array has to be able to hold one
+		vertex per index at most and is shrunk to the actual size afterwards.
 	*/
-	m_quadvertices[vertices_id] = (GLfloat *)calloc(size / 2, 3 * sizeof(GLfloat));
-	//m_quadnormals [vertices_id] = (GLfloat *)calloc(size / 2, 3 * sizeof(GLfloat));
-	m_quadindices [vertices_id] = (GLuint  *)calloc(size, 3 * sizeof(GLuint ));
+	GLfloat *vertices = (GLfloat *)malloc(size * 3 * sizeof(GLfloat));
+	GLuint  *indices  = (GLuint  *)malloc(size * sizeof(GLuint));
 
-	int i   = 0; // index id
-	int vid = 0; // vertex id
+	WeldGrid grid;
+	grid.reserve(size / 2);
+	float distance = std::max<float>(WELD_DISTANCE,
+		m_radius * WELD_DISTANCE_RELATIVE);
 
-	for (auto &row : unprocessed_vert)
+	GLuint i   = 0; // index id
+	GLuint vid = 0; // vertex id
+
+	for (uint32_t node : m_patch_leaves)
 	{
-		for (auto &strip : row)
-		{
-			arrayInsertVector(i++, &vid, m_quadvertices[vertices_id],
-				m_quadindices[vertices_id], strip.second[0]);
-			arrayInsertVector(i++, &vid, m_quadvertices[vertices_id],
-				m_quadindices[vertices_id], strip.second[2]);
-			arrayInsertVector(i++, &vid, m_quadvertices[vertices_id],
-				m_quadindices[vertices_id], strip.second[3]);
-			arrayInsertVector(i++, &vid, m_quadvertices[vertices_id],
-				m_quadindices[vertices_id], strip.second[1]);
-
-			delete [] strip.second;
-		}
+		float incmin = m_nodes.inc_min[node];
+		float incmax = m_nodes.inc_max[node];
+		float azimin = m_nodes.azi_min[node];
+		float azimax = m_nodes.azi_max[node];
+
+		// corners 0, 2, 3, 1
+		indices[i++] = weldVertex(grid, distance, vertices, &vid,
+			SphericalVector3f(m_radius, incmin, azimin));
+		indices[i++] = weldVertex(grid, distance, vertices, &vid,
+			SphericalVector3f(m_radius, incmax, azimin));
+		indices[i++] = weldVertex(grid, distance, vertices, &vid,
+			SphericalVector3f(m_radius, incmax, azimax));
+		indices[i++] = weldVertex(grid, distance, vertices, &vid,
+			SphericalVector3f(m_radius, incmin, azimax));
 	}
 
-	unprocessed_vert.clear();
-	m_vertexnum[vertices_id] = i;
+	if (vid > 0) vertices = (GLfloat *)realloc(vertices, vid * 3 * sizeof(GLfloat));
 
-	int8_t old_id = m_vertices_id;
+	// Use 16-bit indices if all vertices can be addressed with them
+	GLvoid *indexdata = indices;
+	GLenum indextype  = GL_UNSIGNED_INT;
+	size_t indexsize  = sizeof(GLuint);
 
-	m_mutex.lock();
-	m_vertices_id = vertices_id;
+	if (vid <= 0xffff + 1)
+	{
+		GLushort *shortindices = (GLushort *)malloc(size * sizeof(GLushort));
+		for (GLuint n = 0; n < i; n++)
+			shortindices[n] = indices[n];
+
+		free(indices);
+		indexdata = shortindices;
+		indextype = GL_UNSIGNED_SHORT;
+		indexsize = sizeof(GLushort);
+	}
 
-	if (old_id != -1)
+	mesh.vertices  = vertices;
+	mesh.indices   = indexdata;
+	mesh.indextype = indextype;
+	mesh.vertexnum = vid;
+	mesh.indexnum  = i;
+
+	/*
+		Memory statistics: "before" is the amount that was allocated for the same
+		mesh without welding, with size / 2 vertices and 3 * size 32-bit indices
+	*/
+	patch.stats.quads		= size / 4;
+	patch.stats.vertices_before	= size;
+	patch.stats.vertices_after	= vid;
+	patch.stats.bytes_before	= size / 2 * 3 * sizeof(GLfloat) + size * 3 * sizeof(GLuint);
+	patch.stats.bytes_after		= vid * 3 * sizeof(GLfloat) + size * indexsize;
+}
+
+/**
+ * \brief Updates the vertices and indices arrays of all dirty patches
+ *
+ * Only to be called for the outermost SphereFraction. Does not use OpenGL, so it may
+ * run in a background thread; the new arrays are uploaded by the next render().
+ */
+void SphereFraction::updateVertices()
+{
+	SpherePatchMesh empty = { NULL, NULL, GL_UNSIGNED_INT, 0, 0 };
+	std::vector<SpherePatchMesh> built(m_patches.size(), empty);
+
+	SphereMeshStats total = SphereMeshStats();
+	for (uint32_t n = 0; n < m_patches.size(); n++)
+	{
+		SpherePatch &patch = m_patches[n];
+		if (patch.dirty) buildPatchMesh(patch, built[n]);
+		patch.dirty = false;
+
+		total.quads		+= patch.stats.quads;
+		total.vertices_before	+= patch.stats.vertices_before;
+		total.vertices_after	+= patch.stats.vertices_after;
+		total.bytes_before	+= patch.stats.bytes_before;
+		total.bytes_after	+= patch.stats.bytes_after;
+	}
+
+	/*
+		Hand the new versions over to render(), which uploads them to the GPU. If a
+		previous version of a patch has not been picked up yet, it is outdated and
+		dropped, just like patches that are not part of the layout anymore.
+	*/
+	m_mutex.lock();
+	for (uint32_t n = 0; n < m_pending.size(); n++)
 	{
-		free(m_quadvertices[old_id]);
-		//free(m_quadnormals [old_id]);
-		free(m_quadindices[old_id]);
+		if (n < built.size() && built[n].vertices == NULL) continue;
+
+		free(m_pending[n].vertices);
+		free(m_pending[n].indices);
+		m_pending[n] = empty;
 	}
+
+	m_pending.resize(built.size(), empty);
+	for (uint32_t n = 0; n < built.size(); n++)
+		if (built[n].vertices != NULL) m_pending[n] = built[n];
+
+	m_meshstats = total;
 	m_mutex.unlock();
 }
 
+/// Returns the memory statistics of the mesh last built by updateVertices()
+SphereMeshStats SphereFraction::getMeshStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_meshstats;
+}
+
+/**
+ * \brief Prints the memory statistics of the mesh last built by updateVertices()
+ * \param name Name of the celestial body the SphereFraction belongs to
+ */
+void SphereFraction::printMeshStats(std::string name)
+{
+	SphereMeshStats stats = getMeshStats();
+
+	std::cout << name << " mesh: " << stats.quads << " quads, "
+		<< stats.vertices_before << " -> " << stats.vertices_after << " vertices, "
+		<< stats.bytes_before / 1024 << " -> " << stats.bytes_after / 1024 << " KiB"
+		<< std::endl;
+}
+
 /**
  * Find out if the current number of children at a given position should be changed
  * (player has moved relative to it)
  */
-bool SphereFraction::autoNumUpdateReq(SimpleVec3d campos_relative, float intensity,
-		SimpleVec3d position)
+inline bool SphereFraction::autoNumUpdateReq(SimpleVec3d campos_relative,
+		SimpleVec3d position, double lod_distance)
 {
 	float camdist = getVectorLength(campos_relative - position);
 	if (camdist == 0) return false; /* prevent infinite children */
-	return camdist < m_fracsize * intensity;
+	return camdist < lod_distance;
 }
 
 /**
  * \brief Automatically update the number of children depending on the player's position
  * \param campos_rel The relative camera position to the SphereFraction
- * \param intensity The intensity of creating small children SphereFractions; the higher, the more
+ * \param amplitude The terrain height relative to the radius, 0 for smooth spheres
+ *
+ * A node gets children if its geometric error would be visible, see LodManager. The error
+ * of a node is the terrain it flattens (amplitude per unit of its size) and the curvature
+ * of the sphere, its sagitta.
  *
- * This function is supposed to be called only for the outermost SphereFraction.
+ * Builds the adjusted quadtree into m_nodes_next in a single breadth-first pass over the
+ * current one: children are appended behind all nodes of the current level, so iterating
+ * over the indices visits every node without recursion. Patches that contain changed
+ * nodes are marked dirty, so that updateVertices() only rebuilds those.
  */
-bool SphereFraction::autoChildrenNum(SimpleVec3d campos_rel, float intensity)
+bool SphereFraction::autoChildrenNum(SimpleVec3d campos_rel, float amplitude)
 {
 	bool upd_vert_req = false;
 
-	/*
-		update_this_req = true if this vertex should have multiple children
-	*/
-	bool update_req = autoNumUpdateReq(campos_rel, intensity, SimpleVec3d(m_positions[0]));
+	// Distance at which an error of 1 becomes visible, the distance scales linearly
+	double lod_unit = game->getLodManager()->getLodDistance(1.0);
 
-	if (update_req && m_children.size() != CHILDREN_NUM + 1)
-	{
-		upd_vert_req = true;
-		setChildren(CHILDREN_NUM, CHILDREN_NUM);
-	}
-	else if (!update_req && m_children.size() == CHILDREN_NUM + 1)
-	{
-		upd_vert_req = true;
-		setChildren(0, 0);
-	}
+	bool layout_changed = false;
+
+	SphereNodePool &next = m_nodes_next;
+	next.clear();
+	m_rebuild_source.clear();
+	m_rebuild_evaluate.clear();
+	m_rebuild_patch.clear();
+
+	next.copy(m_nodes, 0);
+	m_rebuild_source.push_back(0);
+	m_rebuild_evaluate.push_back(true);
+	m_rebuild_patch.push_back(SPHEREPATCH_NONE);
 
-	if (update_req)
+	for (uint32_t node = 0; node < next.size(); node++)
 	{
-		for (auto &row : m_children)
-		for (auto &child : row)
+		uint32_t source = m_rebuild_source[node];
+		uint32_t patch = m_rebuild_patch[node];
+		uint16_t rows = 0;
+		if (source != SPHERENODE_NO_CHILDREN) rows = m_nodes.child_rows[source];
+
+		/*
+			update_req = true if this node should have multiple children
+		*/
+		bool update_req = false;
+		if (m_rebuild_evaluate[node])
 		{
-			upd_vert_req |= child.second->autoChildrenNum(campos_rel, intensity);
+			SimpleVec3d corner = SphericalVector3f(m_radius, next.inc_min[node],
+				next.azi_min[node]);
+			float size = next.fracsize[node];
+			double error = size * amplitude + size * size / (8 * m_radius);
+			update_req = autoNumUpdateReq(campos_rel, corner, lod_unit * error);
+
+			bool fixed = (node == 0 && m_children_static);
+			bool changed = false;
+
+			if (!fixed && update_req && rows != CHILDREN_NUM)
+			{
+				changed = true;
+				next.addChildren(node, m_radius, CHILDREN_NUM, CHILDREN_NUM);
+				m_rebuild_source.resize(next.size(), SPHERENODE_NO_CHILDREN);
+				m_rebuild_evaluate.resize(next.size(), true);
+				m_rebuild_patch.resize(next.size(), patch);
+			}
+			else if (!fixed && !update_req && rows == CHILDREN_NUM)
+			{
+				changed = true; // node stays a leaf
+			}
+
+			if (changed)
+			{
+				upd_vert_req = true;
+				if (patch == SPHEREPATCH_NONE)	layout_changed = true;
+				else				m_patches[patch].dirty = true;
+				continue;
+			}
+		}
+
+		// Keep the children, they are only adjusted if the camera is close to this node
+		if (rows == 0) continue;
+
+		uint32_t first = m_nodes.first_child[source];
+		uint32_t count = rows * m_nodes.child_cols[source];
+
+		next.first_child[node] = next.size();
+		next.child_rows[node] = rows;
+		next.child_cols[node] = m_nodes.child_cols[source];
+
+		for (uint32_t child = first; child < first + count; child++)
+		{
+			next.copy(m_nodes, child);
+			m_rebuild_source.push_back(child);
+			m_rebuild_evaluate.push_back(update_req);
+			m_rebuild_patch.push_back(node == 0 ? m_rootchild_patch[child - first] : patch);
 		}
 	}
 
+	if (upd_vert_req) std::swap(m_nodes, m_nodes_next);
+	if (layout_changed) buildPatches();
+
 	return upd_vert_req;
 }
 
 /**
- * Render the SphereFraction with all the children. Uses glDrawElements for speed.
+ * Render the SphereFraction with all the children. Draws from buffer objects in GPU memory.
  * This is supposed to be called by the object that owns the SphereFraction, SphereFraction
  * is not a WorldObject and therefore not rendered automatically.
  */
 void SphereFraction::render()
 {
-	if (m_vertices_id == -1) return; // no vertices have been built so far
-
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_NORMAL_ARRAY);
+	uploadPending();
 
 	/*
-		Also use vertices as normals, because they point in the same direction as
-		the surface (regarding the SphereFraction planet as a perfect sphere
+		The vertices are also used as normals, because they point in the same
+		direction as the surface (regarding the SphereFraction planet as a perfect sphere)
 	*/
-	m_mutex.lock();
-	glVertexPointer(3, GL_FLOAT, 0,	m_quadvertices[m_vertices_id]);
-	glNormalPointer(GL_FLOAT, 0,	m_quadvertices[m_vertices_id]);
-
-	if (!game->getWireframe())
-		glDrawElements(GL_QUADS, m_vertexnum[m_vertices_id], GL_UNSIGNED_INT,
-			m_quadindices[m_vertices_id]);
-	else
-		glDrawElements(GL_LINE_STRIP, m_vertexnum[m_vertices_id], GL_UNSIGNED_INT,
-			m_quadindices[m_vertices_id]);
-
-	m_mutex.unlock();
+	GLenum mode = game->getWireframe() ? GL_LINE_STRIP : GL_QUADS;
 
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
-}
-
-/*
-	This function is only to be called for the outermost SphereFraction that contains
-	all the others
-*/
-/// Get vertices of the SphereFraction
-std::vector<std::map<int, SimpleVec3d *>> SphereFraction::getVertices()
-{
-	std::vector<std::map<int, SimpleVec3d *>> vertices;
-
-	if (containsChildren())
-	{
-		vertices = getVerticesContainer();
-	}
-	else
+	for (auto &patch : m_patchbuffers)
 	{
-		std::map<int, SimpleVec3d *> thisrow;
-		thisrow[0] = getVerticesChild();
-
-		vertices.push_back(thisrow);
+		if (patch.id == -1) continue; // no vertices have been uploaded so far
+		patch.buffers[patch.id]->render(mode);
 	}
-
-	return vertices;
 }
 
 /**
- *	retrieves vertices from a SphereFraction that has children;
- *	the std::vector contains the rows, the std::map contains the quad vertices from 0 - n
- *	in a pair
+ * \brief Uploads the patches last built by updateVertices() to GPU memory
+ *
+ * Must be called from the thread that owns the OpenGL context. If the LOD thread is
+ * just handing over new versions, the upload is postponed to the next frame instead
+ * of waiting for it.
  */
-std::vector<std::map<int, SimpleVec3d*>> SphereFraction::getVerticesContainer()
+void SphereFraction::uploadPending()
 {
-	std::vector<std::map<int, SimpleVec3d*>> vertices;
+	if (!m_mutex.try_lock()) return;
 
-	for (auto &row : m_children)
+	m_uploading = m_pending;
+	for (auto &mesh : m_pending)
 	{
-		std::map<int, SimpleVec3d *> verticesrow;
-		int vri = 0;
-
-		for (auto &child : row)
-		{
-			if (child.second->containsChildren())
-			{
-				std::vector<std::map<int, SimpleVec3d *>>
-					childvertices = child.second->getVerticesContainer();
-				vertices.insert(vertices.end(), childvertices.begin(),
-					childvertices.end());
-				childvertices.clear();
-			}
-			else
-			{
-				verticesrow[vri++] = child.second->getVerticesChild();
-			}
-		}
-
-		vertices.push_back(verticesrow);
-		verticesrow.clear();
+		mesh.vertices = NULL;
+		mesh.indices  = NULL;
 	}
+	m_mutex.unlock();
 
-	return vertices;
-}
+	// Adapt to the patch layout, patches that don't exist anymore are deleted
+	while (m_patchbuffers.size() > m_uploading.size())
+	{
+		delete m_patchbuffers.back().buffers[0];
+		delete m_patchbuffers.back().buffers[1];
+		m_patchbuffers.pop_back();
+	}
 
+	SpherePatchBuffers nobuffers = { { NULL, NULL }, -1 };
+	m_patchbuffers.resize(m_uploading.size(), nobuffers);
 
-/**
- * \brief Retrieves vertices from a SphereFraction that has no children
- * \return SimpleVec3d [4] of the four corners of the SphereFraction
- */
+	for (uint32_t n = 0; n < m_uploading.size(); n++)
+	{
+		SpherePatchMesh &mesh = m_uploading[n];
+		SpherePatchBuffers &patch = m_patchbuffers[n];
+		if (mesh.vertices == NULL) continue;
 
-SimpleVec3d *SphereFraction::getVerticesChild()
-{
-	SimpleVec3d *vertices = new SimpleVec3d[4];
+		// Upload into the buffer that was not drawn from in the last frame
+		int8_t buffer_id = (patch.id == 0) ? 1 : 0;
+		if (patch.buffers[buffer_id] == NULL)
+			patch.buffers[buffer_id] = new MeshBuffer(MESH_POSITION);
 
-	vertices[0]  = m_positions[0];
-	vertices[1]  = m_positions[1];
-	vertices[2]  = m_positions[2];
-	vertices[3]  = m_positions[3];
+		patch.buffers[buffer_id]->upload(mesh.vertices, mesh.vertexnum, mesh.indices,
+			mesh.indexnum, mesh.indextype);
+		patch.id = buffer_id;
 
-	return vertices;
+		free(mesh.vertices);
+		free(mesh.indices);
+	}
 }
 
 /**
- * \brief Set the amount of children of a SphereFraction
+ * \brief Set the amount of children of the SphereFraction, removes all deeper levels
  * \param yawres Number of columns
  * \param pitchres Number of rows
  */
@@ -615,68 +909,10 @@ void SphereFraction::setChildren(int yawres, int pitchres)
 	// do not change children if m_children_static is activated
 	if (m_children_static) return;
 
-	for (auto &row : m_children)
-	for (auto child : row)
-		delete child.second;
-
-	m_children.clear();
-
-	if (yawres == 0 || pitchres == 0) return;
-
-	float pitchperc1 = 0;
-	float pitchperc2 = 0;
-
-	for (int pitchn = 0; pitchn <= pitchres; pitchn++)
-	{
-		std::map<int, SphereFraction *> row;
-		row.clear();
-
-		pitchperc1 = pitchperc2;
-		pitchperc2 = (pitchn * 1.) / pitchres;
-
-		float yawperc = 0;
-
-		SphericalVector3f p[4]; // contains children's positions
-		p[0] = getChildPosition(m_positions, 0, pitchperc1);
-		p[2] = getChildPosition(m_positions, 0, pitchperc2);
-
-		int yawn = 0;
-		for (; yawn <= yawres + 1; yawn++)
-		{
-			yawperc = (yawn * 1.) / yawres;
-
-			p[1] = getChildPosition(m_positions, yawperc, pitchperc1);
-			p[3] = getChildPosition(m_positions, yawperc, pitchperc2);
-
-			row[yawn] = new SphereFraction(p);
-
-			p[0] = p[1];
-			p[2] = p[3];
-		}
+	m_nodes_next.clear();
+	m_nodes_next.copy(m_nodes, 0);
+	m_nodes_next.addChildren(0, m_radius, yawres, pitchres);
 
-		m_children.push_back(row);
-	}
-}
-
-/**
- * Interpolate between two azimuth / inclination values to get the SphericalVector3f position for a
- * child SphereFraction.
- */
-inline SphericalVector3f SphereFraction::getChildPosition(SphericalVector3f *p, float yawperc, float pitchperc)
-{
-	float azi = linInterpolate(p[0].azimuth, p[3].azimuth, yawperc);
-	float inc = linInterpolate(p[0].inclination, p[3].inclination, pitchperc);
-
-	return SphericalVector3f(p[0].radius, inc, azi);
-}
-
-/**
- * \brief Linear interpolation between two float values
- * \param val1 First value
- * \param val2 Second Value
- * \param perc Between 0 (like val1) and 1 (val2)
- */
-inline float SphereFraction::linInterpolate(float val1, float val2, float perc)
-{
-	return val1 + (val2 - val1) * perc;
+	std::swap(m_nodes, m_nodes_next);
+	buildPatches();
 }
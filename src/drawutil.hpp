@@ -7,6 +7,8 @@
 #ifndef _DRAWUTIL_H
 #define _DRAWUTIL_H
 
+class MeshBuffer;
+
 /// A 2d image to be drawn by a StaticObject
 class Image2d
 {
@@ -44,100 +46,177 @@ void makeCuboidSimple(SimpleVec3d c1, SimpleVec3d c2);
 // Procedural generation sphere
 void makeProceduralSphere(float radius, float dyaw, float dpitch);
 
-/*
-	concerning: SphereFraction::setChildren, bool *forcepos[4]
-	When calling setChildren, do not dipslay all vertices on the given side (side [0] - [3])
-	to interpolate different numbers of children in adjacent containers
-*/
+/// Size of the mesh last built by SphereFraction::updateVertices, before and after welding
+struct SphereMeshStats
+{
+	size_t quads;
+	size_t vertices_before;
+	size_t vertices_after;
+	size_t bytes_before;
+	size_t bytes_after;
+};
+
+#define SPHERENODE_NO_CHILDREN 0xffffffff
+
+/**
+ * \brief The quadtree nodes of a SphereFraction, stored as flat structure-of-arrays
+ *
+ * Nodes are addressed by index and stored in breadth-first order, node 0 is the whole
+ * SphereFraction. The children of a node are contiguous, row by row, starting at
+ * first_child. Every node is a quad that is bounded by two inclinations and two azimuths,
+ * so all of them can be visited with a plain loop over the arrays.
+ */
+struct SphereNodePool
+{
+	std::vector<float> inc_min;	// inclination of corners 0 and 1
+	std::vector<float> inc_max;	// inclination of corners 2 and 3
+	std::vector<float> azi_min;	// azimuth of corners 0 and 2
+	std::vector<float> azi_max;	// azimuth of corners 1 and 3
+
+	// diagonal length through quad IF IT WAS AT THE EQUATOR
+	// (so that all nth children have the same fracsize)
+	std::vector<float> fracsize;
+
+	std::vector<uint32_t> first_child;	// SPHERENODE_NO_CHILDREN for leaves
+	std::vector<uint16_t> child_rows;
+	std::vector<uint16_t> child_cols;
+
+	uint32_t size()
+		{ return inc_min.size(); }
+	void clear();
+	uint32_t push(float radius, float incmin, float incmax, float azimin, float azimax);
+	uint32_t copy(SphereNodePool &from, uint32_t node);
+	void addChildren(uint32_t node, float radius, int yawres, int pitchres);
+};
+
+#define SPHEREPATCH_NONE 0xffffffff
+
+/**
+ * \brief A fixed block of children of the outermost SphereFraction node
+ *
+ * Every patch has its own mesh, so only patches whose subdivision has changed are
+ * rebuilt and uploaded again.
+ */
+struct SpherePatch
+{
+	std::vector<uint32_t> nodes; // children of the outermost node in this patch
+	bool dirty;
+	SphereMeshStats stats;
+};
+
+/// Mesh of a SpherePatch that updateVertices() has built, but render() has not uploaded yet
+struct SpherePatchMesh
+{
+	GLfloat *vertices;	// NULL if there is no new version
+	GLvoid  *indices;	// GLushort if possible, otherwise GLuint
+	GLenum   indextype;
+	GLuint   vertexnum;
+	GLuint   indexnum;
+};
+
+/**
+ * \brief GPU side of a SpherePatch, only accessed by render()
+ *
+ * New versions are uploaded into the MeshBuffer that is not in use, so that the buffer
+ * the previous frames have been drawn from never has to be overwritten. Which one is to
+ * be used is saved in id; if id == -1, nothing has been uploaded so far (--> no rendering)
+ */
+struct SpherePatchBuffers
+{
+	MeshBuffer *buffers[2];
+	int8_t id;
+};
 
 /// A quad on a sphere surface, may also contain subdivisions of itself for procedural generation
 class SphereFraction
 {
 	public:
-		SphereFraction();
-		~SphereFraction();
-
 		SphereFraction(SphericalVector3f *p); // p[4], array of the 4 positions
+		~SphereFraction();
 
 		static SphereFraction *makePrototype(float radius, float dyaw, float dpitch);
 		void render();
 		void setChildren(int yawres, int pitchres);
 		bool containsChildren()
-			{ return m_children.size() > 0; };
+			{ return m_nodes.first_child[0] != SPHERENODE_NO_CHILDREN; };
 		void updateVertices();
-		std::vector<std::map<int, SphereFraction *>> *getChildren()
-			{ return &m_children; };
 
 		/*
 			campos_relative is the relative position of the camera to the origin
 			of the sphere's coordinate system (including translations)
 			autoChildrenNum automatically adds and removes children
-			based on how far away the camera is from the fraction
+			based on how large their geometric error appears on the screen (see
+			LodManager), amplitude is the terrain height relative to the radius
 
 			returns true if a updateVertices() is required afterwards
 		*/
-		bool autoChildrenNum(SimpleVec3d campos_relative, float intensity);
+		bool autoChildrenNum(SimpleVec3d campos_relative, float amplitude);
 		void setChildrenStatic(bool value)
 			{ m_children_static = value; };
 
+		SphereMeshStats getMeshStats();
+		void printMeshStats(std::string name);
+
 	private:
-		inline static float linInterpolate(float val1, float val2, float perc);
-		inline static SphericalVector3f getChildPosition
-				(SphericalVector3f *p, float yawperc, float pitchperc);
+		void uploadPending();
+		void buildPatches();
+		void buildPatchMesh(SpherePatch &patch, SpherePatchMesh &mesh);
 
 		/*
 			Determine if an update of children numbers would be required if
 			the given vertex is at position; helper function
 		*/
-		bool autoNumUpdateReq(SimpleVec3d campos_relative, float intensity,
-			SimpleVec3d position);
+		inline static bool autoNumUpdateReq(SimpleVec3d campos_relative,
+			SimpleVec3d position, double lod_distance);
+
+		float m_radius;
 
 		/*
-			Checks if vertex is already contained in vertices and returns index if
-			it is already there, otherwise returns VERTEX_NO_EXIST
+			m_nodes is the current quadtree, autoChildrenNum builds the next one in
+			m_nodes_next and swaps them if anything has changed; both keep their
+			storage, so rebuilding doesn't allocate once the tree has settled.
+			m_rebuild_source / m_rebuild_evaluate hold, for every node in m_nodes_next,
+			the index of the same node in m_nodes (or SPHERENODE_NO_CHILDREN if it is
+			new) and whether its children are to be adjusted to the camera position
 		*/
-		inline static uint32_t vertexExistsAlready(GLfloat *vertices, GLuint vertexnum, SimpleVec3d vertex);
+		SphereNodePool m_nodes;
+		SphereNodePool m_nodes_next;
+		std::vector<uint32_t> m_rebuild_source;
+		std::vector<bool> m_rebuild_evaluate;
 
 		/*
-			Adds a vertex to an array, helper function for updateVertices()
+			m_patches is the patch layout, it is only changed together with the
+			children of the outermost node. m_rebuild_patch holds the patch of
+			every node in m_nodes_next, m_rootchild_patch the patch of every child
+			of the outermost node; m_traverse_stack and m_patch_leaves are reused
+			by updateVertices()
 		*/
-		inline static void arrayInsertVector(int i, int *vid,
-			GLfloat *m_quadvertices, GLuint *m_quadindices, SimpleVec3d vertex);
-
-		std::vector<std::map<int, SimpleVec3d *>> getVertices();
-		std::vector<std::map<int, SimpleVec3d *>> getVerticesContainer();
-
-		SimpleVec3d* getVerticesChild(); // returns 4 vertices
-
-		SphericalVector3f m_positions[4];
-		std::vector<std::map<int, SphereFraction *>> m_children;
+		std::vector<SpherePatch> m_patches;
+		std::vector<uint32_t> m_rebuild_patch;
+		std::vector<uint32_t> m_rootchild_patch;
+		std::vector<uint32_t> m_traverse_stack;
+		std::vector<uint32_t> m_patch_leaves;
 
 		/*
-			m_quadvertices / m_quadnormals / m_quadindices
-			contains the elements for a QUAD_STRIP, but is only used on the outermost
-			SphereFraction, that is not a child of any other one
-			Contains 2 arrays of the vertices / normals / indices / uint of vertexnum
-			so that one can always be updated while the other is in use. Which one is to
-			be used is saved in m_vertices_id; if m_vertices_id == -1, no vertices have
-			been built so far (--> no rendering)
+			m_pending contains one entry per patch of the most recent layout, with the
+			meshes that have not been uploaded yet. render() moves them into
+			m_uploading (so that the mutex is released before any OpenGL call) and
+			uploads them into m_patchbuffers.
 		*/
-		GLfloat *m_quadvertices[2];
-		//GLfloat *m_quadnormals[2];
-		GLuint  *m_quadindices[2];
-		GLuint   m_vertexnum[2];
-		float m_fracsize; // diagonal length through quad IF IT WAS AT THE EQUATOR
-				  // (so that all nth children have the same fracsize)
+		std::vector<SpherePatchMesh> m_pending;
+		std::vector<SpherePatchMesh> m_uploading;
+		std::vector<SpherePatchBuffers> m_patchbuffers;
 
-		int8_t m_vertices_id;
+		SphereMeshStats m_meshstats;
 
 		/*
-			Mutex is only locked, while rendering (transferring the vertices / normals /
-			indices arrays)
+			Mutex is only locked while handing over m_pending and m_meshstats, the
+			LOD thread never has to wait for OpenGL calls
 		*/
 		std::mutex m_mutex;
 
-		/* Don't change number of children if m_children_static is true
-			(used for outermost Fraction) */
+		/* Don't change number of children of the outermost node if
+			m_children_static is true */
 		bool m_children_static;
 };
 
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <chrono>
+
+#include "objects.hpp"
+#include "config.hpp"
+#include "ecs.hpp"
+
+// Number of steps per entity count in benchmarkEntities()
+#define ECS_BENCHMARK_STEPS 100
+
+/**
+ * \brief Creates a new entity without any components
+ */
+Entity EntityStore::create()
+{
+	if (m_free.empty()) return m_next++;
+
+	Entity entity = m_free.back();
+	m_free.pop_back();
+	return entity;
+}
+
+/**
+ * \brief Removes all components of the entity and releases its ID
+ * \param entity The entity to destroy
+ */
+void EntityStore::destroy(Entity entity)
+{
+	m_transforms.remove(entity);
+	m_kinematics.remove(entity);
+	m_masses.remove(entity);
+	m_free.push_back(entity);
+}
+
+/**
+ * \brief Kinematics system: moves all entities that have a KinematicsComponent
+ * \param dtime The time in seconds that passed since this was called last
+ *
+ * Same integration as PhysicalObject::physicalMove(). Entities with kinematics
+ * must also have a TransformComponent.
+ */
+void EntityStore::stepKinematics(float dtime)
+{
+	std::vector<KinematicsComponent> &kinematics = m_kinematics.getComponents();
+	const std::vector<Entity> &entities = m_kinematics.getEntities();
+
+	for (size_t i = 0; i < kinematics.size(); i++)
+	{
+		SimpleVec3d &pos = m_transforms.get(entities[i]).pos;
+		pos += kinematics[i].velocity * dtime;
+		kinematics[i].velocity += kinematics[i].acceleration * dtime;
+	}
+}
+
+/*
+	Benchmark
+*/
+
+/// PhysicalObject that only moves, for comparison with EntityStore::stepKinematics()
+class BenchmarkObject : public PhysicalObject
+{
+	public:
+		BenchmarkObject(SimpleVec3d velocity, SimpleVec3d acceleration)
+		{
+			m_velocity = velocity;
+			m_acceleration = acceleration;
+		}
+
+		void step(float dtime)
+			{ physicalMove(dtime); }
+};
+
+/**
+ * \brief Compares the step throughput of WorldObjects and the EntityStore
+ *
+ * Moves 10k and 100k objects, once as heap allocated PhysicalObjects through the virtual
+ * step() and once as components through the kinematics system. Started with the
+ * --benchmark-ecs command line option, does not need a window.
+ */
+void benchmarkEntities()
+{
+	for (uint32_t num : {10000, 100000})
+	{
+		std::vector<GenericObject *> objects;
+		EntityStore store;
+		for (uint32_t i = 0; i < num; i++)
+		{
+			SimpleVec3d velocity(i % 7, i % 11, i % 13);
+			SimpleVec3d acceleration(0, -9.81 * USC, 0);
+			objects.push_back(new BenchmarkObject(velocity, acceleration));
+
+			Entity entity = store.create();
+			store.getTransforms().add(entity, TransformComponent { SimpleVec3d() });
+			store.getKinematics().add(entity, KinematicsComponent { velocity, acceleration });
+		}
+
+		auto starttime = std::chrono::steady_clock::now();
+		for (uint16_t s = 0; s < ECS_BENCHMARK_STEPS; s++)
+			for (auto obj : objects)
+				obj->step(0.01);
+		std::chrono::duration<double> objects_time = std::chrono::steady_clock::now() - starttime;
+
+		starttime = std::chrono::steady_clock::now();
+		for (uint16_t s = 0; s < ECS_BENCHMARK_STEPS; s++)
+			store.stepKinematics(0.01);
+		std::chrono::duration<double> store_time = std::chrono::steady_clock::now() - starttime;
+
+		double objects_rate = num * ECS_BENCHMARK_STEPS / objects_time.count();
+		double store_rate = num * ECS_BENCHMARK_STEPS / store_time.count();
+		std::cout << num << " entities: WorldObjects " << objects_rate / 1e6
+			<< "M steps/s, EntityStore " << store_rate / 1e6 << "M steps/s ("
+			<< store_rate / objects_rate << "x)" << std::endl;
+
+		for (auto obj : objects)
+			delete obj;
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef _ECS_H
+#define _ECS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "util.hpp"
+
+/// Identifies an entity in an EntityStore, IDs of destroyed entities are reused
+typedef uint32_t Entity;
+
+// Sparse index of entities that do not have a component
+#define ECS_NO_COMPONENT 0xffffffff
+
+// Entity of objects that are not in an EntityStore
+#define ECS_NO_ENTITY 0xffffffff
+
+/// Position in the WorldEnvironment
+struct TransformComponent
+{
+	SimpleVec3d pos;
+};
+
+/// Movement with a constant acceleration, moved by EntityStore::stepKinematics()
+struct KinematicsComponent
+{
+	SimpleVec3d velocity;
+	SimpleVec3d acceleration;
+};
+
+/// Gravitational mass in kg, read by the GravityManager
+struct MassComponent
+{
+	double mass;
+};
+
+/**
+ * \brief Contiguous storage of one component type (sparse set)
+ *
+ * The components are packed in m_components, so systems can iterate over them without
+ * chasing pointers. Removing a component moves the last one into the gap.
+ */
+template <typename T>
+class ComponentArray
+{
+	public:
+		void add(Entity entity, const T &component)
+		{
+			if (entity >= m_index.size())
+				m_index.resize(entity + 1, ECS_NO_COMPONENT);
+
+			m_index[entity] = m_components.size();
+			m_components.push_back(component);
+			m_entities.push_back(entity);
+		}
+
+		void remove(Entity entity)
+		{
+			if (!has(entity)) return;
+
+			uint32_t index = m_index[entity];
+			m_components[index] = m_components.back();
+			m_entities[index] = m_entities.back();
+			m_index[m_entities[index]] = index;
+
+			m_components.pop_back();
+			m_entities.pop_back();
+			m_index[entity] = ECS_NO_COMPONENT;
+		}
+
+		bool has(Entity entity)
+			{ return entity < m_index.size() && m_index[entity] != ECS_NO_COMPONENT; }
+
+		/// Component of the entity, which must have one
+		T &get(Entity entity)
+			{ return m_components[m_index[entity]]; }
+
+		/// Packed components, valid until components are added or removed
+		std::vector<T> &getComponents()
+			{ return m_components; }
+
+		/// Entity of every packed component
+		const std::vector<Entity> &getEntities()
+			{ return m_entities; }
+
+	private:
+		std::vector<T> m_components;
+		std::vector<Entity> m_entities;
+		std::vector<uint32_t> m_index;
+};
+
+/**
+ * \brief Component storage for entities of the WorldEnvironment
+ *
+ * Instead of stepping every object through a virtual step(), objects that have been
+ * ported keep their state in the component arrays and the systems (like stepKinematics())
+ * process all entities at once. Not thread-safe, only use it in the main thread.
+ */
+class EntityStore
+{
+	public:
+		EntityStore() : m_next(0) {};
+
+		Entity create();
+		void destroy(Entity entity);
+
+		ComponentArray<TransformComponent> &getTransforms()
+			{ return m_transforms; }
+		ComponentArray<KinematicsComponent> &getKinematics()
+			{ return m_kinematics; }
+		ComponentArray<MassComponent> &getMasses()
+			{ return m_masses; }
+
+		void stepKinematics(float dtime);
+
+	private:
+		Entity m_next;
+		std::vector<Entity> m_free;
+
+		ComponentArray<TransformComponent> m_transforms;
+		ComponentArray<KinematicsComponent> m_kinematics;
+		ComponentArray<MassComponent> m_masses;
+};
+
+void benchmarkEntities();
+
+#endif
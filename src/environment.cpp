@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <vector>
@@ -7,13 +8,31 @@
 
 #include "environment.hpp"
 #include "spaceship.hpp"
+#include "teleport.hpp"
 #include "gravity.hpp"
+#include "audio.hpp"
 #include "config.hpp"
 
 /*
 	World Environment
 */
 
+/// Adds obj to index if it is a T
+template <typename T>
+static void addToIndex(std::vector<WorldObjectRef<T>> &index, WorldObject *obj)
+{
+	T *iface = dynamic_cast<T *>(obj);
+	if (iface) index.push_back(WorldObjectRef<T> { obj, iface });
+}
+
+/// Removes obj from index, if it is contained
+template <typename T>
+static void removeFromIndex(std::vector<WorldObjectRef<T>> &index, WorldObject *obj)
+{
+	index.erase(std::remove_if(index.begin(), index.end(),
+		[obj] (const WorldObjectRef<T> &ref) { return ref.obj == obj; }), index.end());
+}
+
 /**
  * \brief Creates a new WorldEnvironment
  *
@@ -44,18 +63,24 @@ WorldEnvironment::~WorldEnvironment()
  * \brief Calls step on all the Objects.
  * \param dtime The time in seconds that passed since this was called last.
  *
- * Creates a GravityManager for the current WorldEnvironment, calls GenericObject::stepMainThread()
- * all the objects and then tells the EnvironmentStepThreadManager to execute the step() functions
- * in a mulithreaded environment.
+ * Creates a GravityManager for the current WorldEnvironment, runs the systems of the EntityStore,
+ * calls GenericObject::stepMainThread() all the objects and then tells the
+ * EnvironmentStepThreadManager to execute the step() functions in a mulithreaded environment.
  */
 void WorldEnvironment::step(float dtime)
 {
-	m_gravityman = new GravityManager(&m_objects);
+	// MassObjects still move themselves, the GravityManager reads their positions from the store
+	for (auto &mass : m_masses)
+		m_entities.getTransforms().get(mass.iface->getMassEntity()).pos = mass.obj->getPos();
+	m_gravityman = new GravityManager(m_entities);
+
+	m_entities.stepKinematics(dtime);
 
-	for(auto obj : m_objects)
+	// Not a range-based loop, as stepMainThread() may add objects (FireParticleSource)
+	for (size_t i = 0; i < m_objects.size(); i++)
 	{
-		obj->stepMainThread(dtime);
-		m_threadman->addObject(obj);
+		m_objects[i]->stepMainThread(dtime);
+		m_threadman->addObject(m_objects[i]);
 	}
 
 	m_threadman->executeStep(dtime);
@@ -67,6 +92,7 @@ void WorldEnvironment::step(float dtime)
 	{
 		if ((*obj)->isObsolete())
 		{
+			removeFromIndices(*obj);
 			delete (*obj);
 			m_objects.erase(obj);
 		}
@@ -83,6 +109,34 @@ void WorldEnvironment::step(float dtime)
 void WorldEnvironment::addObject(WorldObject *obj)
 {
 	m_objects.push_back(obj);
+
+	addToIndex(m_masses, obj);
+	addToIndex(m_teleport_targets, obj);
+	addToIndex(m_audio_objects, obj);
+
+	// Masses are also entities, for the GravityManager
+	MassObject *mass = dynamic_cast<MassObject *>(obj);
+	if (mass)
+	{
+		Entity entity = m_entities.create();
+		m_entities.getTransforms().add(entity, TransformComponent { obj->getPos() });
+		m_entities.getMasses().add(entity, MassComponent { mass->getMass() });
+		mass->setMassEntity(entity);
+	}
+}
+
+/**
+ * \brief Removes an object from the typed indices, before it is deleted
+ * \param obj The object to remove
+ */
+void WorldEnvironment::removeFromIndices(WorldObject *obj)
+{
+	MassObject *mass = dynamic_cast<MassObject *>(obj);
+	if (mass) m_entities.destroy(mass->getMassEntity());
+
+	removeFromIndex(m_masses, obj);
+	removeFromIndex(m_teleport_targets, obj);
+	removeFromIndex(m_audio_objects, obj);
 }
 
 /**
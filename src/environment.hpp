@@ -16,15 +16,27 @@
 #include <mutex>
 
 #include "util.hpp"
+#include "ecs.hpp"
 
 class WorldObject;
 class StaticObject;
+class MassObject;
+class AudioObject;
+class TeleportTarget;
 class GenericObject;
 class GravityManager;
 class StepThreadObject;
 class EnvironmentStepThread;
 class EnvironmentStepThreadManager;
 
+/// Entry of a typed index of the WorldEnvironment: an object and the object as T
+template <typename T>
+struct WorldObjectRef
+{
+	WorldObject *obj;
+	T *iface;
+};
+
 /// Base class for WorldEnvironment and StaticEnvironment, contains Objects
 class Environment
 {
@@ -43,14 +55,37 @@ class WorldEnvironment  : public Environment
 		WorldEnvironment();
 		~WorldEnvironment();
 
-		std::vector<WorldObject*> getObjects()
+		/// All objects; only valid until objects are added or removed
+		const std::vector<WorldObject*> &getObjects()
 			{ return m_objects; };
+
+		/*
+			Typed indices of the objects that implement MassObject, TeleportTarget or
+			AudioObject, maintained when objects are added or removed
+		*/
+		const std::vector<WorldObjectRef<MassObject>> &getMassObjects()
+			{ return m_masses; };
+		const std::vector<WorldObjectRef<TeleportTarget>> &getTeleportTargets()
+			{ return m_teleport_targets; };
+		const std::vector<WorldObjectRef<AudioObject>> &getAudioObjects()
+			{ return m_audio_objects; };
+
+		/// Components of the objects that have been ported to entities
+		EntityStore &getEntities()
+			{ return m_entities; };
+
 		void addObject(WorldObject *obj);
 		void step(float dtime);
 		SimpleVec3d getGravityAcc(SimpleVec3d pos);
 
 	private:
+		void removeFromIndices(WorldObject *obj);
+
 		std::vector<WorldObject*> m_objects;
+		std::vector<WorldObjectRef<MassObject>> m_masses;
+		std::vector<WorldObjectRef<TeleportTarget>> m_teleport_targets;
+		std::vector<WorldObjectRef<AudioObject>> m_audio_objects;
+		EntityStore m_entities;
 		GravityManager *m_gravityman;
 		EnvironmentStepThreadManager *m_threadman;
 };
@@ -62,7 +97,8 @@ class StaticEnvironment : public Environment
 		StaticEnvironment() {};
 		~StaticEnvironment();
 
-		std::vector<StaticObject*> getObjects()
+		/// All objects; only valid until objects are added or removed
+		const std::vector<StaticObject*> &getObjects()
 			{ return m_objects; };
 		void addObject(StaticObject *obj);
 		void step(float dtime);
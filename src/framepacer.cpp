@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <math.h>
+
+#include "framepacer.hpp"
+#include "gamevars.hpp"
+#include "gllibs.hpp"
+#include "config.hpp"
+
+#if defined(PLANETHER_WINDOWS)
+#include <GL/wglew.h>
+#elif !defined(__APPLE__)
+#include <GL/glxew.h>
+#endif
+
+// The last part of the wait (in seconds) is spent spinning instead of sleeping
+#define FRAMEPACER_SPIN_TIME 0.002
+
+/*
+	With vsync, the limit is raised by this factor so that the limiter does not compete
+	with the buffer swap when the target rate is close to the refresh rate
+*/
+#define FRAMEPACER_VSYNC_MARGIN 1.1
+
+// Frame rate while the window is not visible
+#define FRAMEPACER_HIDDEN_RATE 10
+
+// Number of frames the statistics are calculated of
+#define FRAMEPACER_STATS_FRAMES 120
+
+/**
+ * \brief Reads the target rate from the configuration and enables vsync if configured
+ *
+ * Must be called after the window has been created.
+ */
+FramePacer::FramePacer() :
+m_vsync(false),
+m_visible(true),
+m_last_frame(std::chrono::steady_clock::now()),
+m_deadline(m_last_frame),
+m_frametimes_pos(0),
+m_mean(0),
+m_deviation(0)
+{
+	double rate = config->getDouble("frame_rate_limit", 60);
+	if (config->getBool("vsync", true))
+		m_vsync = enableVsync();
+
+	if (m_vsync && rate > 0)
+		rate *= FRAMEPACER_VSYNC_MARGIN;
+	m_interval = rate > 0 ? 1. / rate : 0;
+
+	std::cout << "Frame pacing: ";
+	if (rate > 0) std::cout << rate << " FPS limit";
+	else std::cout << "no limit";
+	std::cout << (m_vsync ? ", vsync" : ", no vsync") << std::endl;
+}
+
+/**
+ * \brief Sets the swap interval to 1, returns false if the driver does not support that
+ */
+bool FramePacer::enableVsync()
+{
+#if defined(PLANETHER_WINDOWS)
+	if (WGLEW_EXT_swap_control)
+		return wglSwapIntervalEXT(1);
+#elif !defined(__APPLE__)
+	if (GLXEW_EXT_swap_control)
+	{
+		glXSwapIntervalEXT(glXGetCurrentDisplay(), glXGetCurrentDrawable(), 1);
+		return true;
+	}
+	if (GLXEW_MESA_swap_control)
+		return glXSwapIntervalMESA(1) == 0;
+	if (GLXEW_SGI_swap_control)
+		return glXSwapIntervalSGI(1) == 0;
+#endif
+	return false;
+}
+
+/**
+ * \brief Waits for the start of the next frame
+ * \return The time in seconds since the last call returned
+ *
+ * Deadlines follow each other in steady intervals. If a frame took so long that the
+ * next deadline has passed already, the schedule starts over instead of catching up
+ * with a burst of short frames.
+ */
+double FramePacer::wait()
+{
+	double interval = m_visible ? m_interval : 1. / FRAMEPACER_HIDDEN_RATE;
+	auto now = std::chrono::steady_clock::now();
+
+	if (interval > 0)
+	{
+		auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(interval));
+		m_deadline += step;
+		if (m_deadline < now)
+			m_deadline = now;
+
+		auto spin = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(FRAMEPACER_SPIN_TIME));
+		if (m_deadline - now > spin)
+			std::this_thread::sleep_for(m_deadline - now - spin);
+
+		while (std::chrono::steady_clock::now() < m_deadline)
+			std::this_thread::yield();
+
+		now = std::chrono::steady_clock::now();
+	}
+
+	double frametime = std::chrono::duration<double>(now - m_last_frame).count();
+	m_last_frame = now;
+	updateStats(frametime);
+
+	return frametime;
+}
+
+/**
+ * \brief Returns the time in seconds since wait() returned
+ *
+ * Called before the buffer swap, this is the time spent on the current frame without the
+ * pacing and vsync waits.
+ */
+double FramePacer::getWorkTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_last_frame).count();
+}
+
+/**
+ * \brief Adds a frame time to the statistics and recalculates mean and deviation
+ * \param frametime The time between two frames in seconds
+ */
+void FramePacer::updateStats(double frametime)
+{
+	if (m_frametimes.size() < FRAMEPACER_STATS_FRAMES)
+		m_frametimes.push_back(frametime);
+	else
+		m_frametimes[m_frametimes_pos] = frametime;
+	m_frametimes_pos = (m_frametimes_pos + 1) % FRAMEPACER_STATS_FRAMES;
+
+	double sum = 0, sqsum = 0;
+	for (double t : m_frametimes)
+	{
+		sum += t;
+		sqsum += t * t;
+	}
+
+	m_mean = sum / m_frametimes.size();
+	m_deviation = sqrt(std::max(0., sqsum / m_frametimes.size() - m_mean * m_mean));
+}
@@ -0,0 +1,59 @@
+#ifndef _FRAMEPACER_H
+#define _FRAMEPACER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+
+/**
+ * \brief Limits the frame rate of the GLUT idle loop and measures the frame times
+ *
+ * wait() is called at the beginning of every step and returns at the start of the next
+ * frame: it sleeps for most of the remaining time and spins for the last
+ * FRAMEPACER_SPIN_TIME, as sleeping is not precise enough. If vsync could be enabled,
+ * the buffer swap paces the frames and the limiter only catches frames that the driver
+ * does not block (e.g. when the window is covered). While the window is not visible,
+ * the game only runs at FRAMEPACER_HIDDEN_RATE.
+ */
+class FramePacer
+{
+	public:
+		FramePacer();
+
+		double wait();
+
+		/// Tells the FramePacer whether the window can be seen
+		void setVisible(bool visible)
+			{ m_visible = visible; }
+
+		/// Average time between two frames in seconds, over the last FRAMEPACER_STATS_FRAMES
+		double getFrameTimeMean()
+			{ return m_mean; }
+
+		/// Standard deviation of the time between two frames in seconds
+		double getFrameTimeDeviation()
+			{ return m_deviation; }
+
+		bool getVsync()
+			{ return m_vsync; }
+
+		double getWorkTime();
+
+	private:
+		static bool enableVsync();
+		void updateStats(double frametime);
+
+		double m_interval;	// target time between two frames in seconds, 0 = no limit
+		bool m_vsync;
+		bool m_visible;
+
+		std::chrono::steady_clock::time_point m_last_frame;
+		std::chrono::steady_clock::time_point m_deadline;
+
+		std::vector<double> m_frametimes;	// ring buffer for the statistics
+		uint16_t m_frametimes_pos;
+		double m_mean;
+		double m_deviation;
+};
+
+#endif
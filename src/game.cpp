@@ -15,6 +15,9 @@
 #include "util.hpp"
 #include "game.hpp"
 #include "hud.hpp"
+#include "lightregistry.hpp"
+#include "framepacer.hpp"
+#include "lod.hpp"
 #include "map.hpp"
 
 /***********************
@@ -33,6 +36,9 @@ Game::Game() :
 m_crosshair(new CrossHair()),
 m_hud_physics(new PhysicsInformation),
 m_hud_planetloc(new PlanetLocator),
+m_lod(new LodManager),
+m_lights(new LightRegistry),
+m_pacer(new FramePacer),
 m_tport_overlay(false),
 m_seed(config->getInt("seed", 4)),
 m_wireframe(false),
@@ -63,6 +69,9 @@ Game::~Game()
 	delete m_cam->getSkyBox();
 	delete m_cam->getShaderManager();
 	delete m_cam;
+	delete m_lod; // after the WorldEnvironment, its bodies remove themselves
+	delete m_lights; // same for the emitters
+	delete m_pacer;
 }
 
 /**
@@ -119,7 +128,7 @@ void Game::init()
  * \brief Performs a step on the game
  *
  * To be called by Game::step_wrapper(), which is registered by Game::init(). Executed when GLUT
- * is in idle (glutIdleFunc()). Calculates dtime (delta time), handles keyboard + mouse (MS Windows)
+ * is in idle (glutIdleFunc()). Waits for the next frame (FramePacer), calculates dtime (delta time), handles keyboard + mouse (MS Windows)
  * input and calls step on the environments. Posts a redisplay via glutPostRedisplay().
  */
 void Game::step()
@@ -127,7 +136,7 @@ void Game::step()
 	/*
 		Timing
 	*/
-	float dtime = (glutGet(GLUT_ELAPSED_TIME) / 1000. - m_time_real) * m_speed;
+	float dtime = m_pacer->wait() * m_speed;
 	m_time += dtime;
 	m_time_real = glutGet(GLUT_ELAPSED_TIME) / 1000.;
 
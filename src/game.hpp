@@ -7,6 +7,9 @@ class StaticEnvironment;
 class AudioEnvironment;
 class WorldEnvironment;
 class PlanetLocator;
+class LightRegistry;
+class FramePacer;
+class LodManager;
 class SpaceShip;
 class CrossHair;
 class Camera;
@@ -55,6 +58,18 @@ class Game
 		PlanetLocator *getPlanetLocator()
 			{ return m_hud_planetloc; }
 
+		/// Returns a reference to the LodManager
+		LodManager *getLodManager()
+			{ return m_lod; }
+
+		/// Returns a reference to the LightRegistry
+		LightRegistry *getLightRegistry()
+			{ return m_lights; }
+
+		/// Returns a reference to the FramePacer
+		FramePacer *getFramePacer()
+			{ return m_pacer; }
+
 		/// Set whether an overlay captures keyboard input
 		void setTportOverlay(bool val)
 			{ m_tport_overlay = val; };
@@ -88,8 +103,8 @@ class Game
 			{ return m_lost; }
 
 		/// Retrieve time that has gone by in the simulated universe
-		/// since its creation, in seconds
-		float getUniverseTime()
+		/// since its creation, in seconds (double, stays exact after time warp)
+		double getUniverseTime()
 			{ return m_time; }
 
 		/// Retrieve time since the game was started, in seconds (real time)
@@ -113,6 +128,9 @@ class Game
 		PhysicsInformation *m_hud_physics;
 		PlanetLocator *m_hud_planetloc;
 		Camera *m_cam;
+		LodManager *m_lod;
+		LightRegistry *m_lights;
+		FramePacer *m_pacer;
 
 		bool m_tport_overlay;
 		int m_seed;
@@ -121,7 +139,7 @@ class Game
 
 		// Timing
 		float m_speed;
-		float m_time;
+		double m_time;
 		float m_time_real;
 };
 
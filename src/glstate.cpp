@@ -0,0 +1,307 @@
+#include <string.h>
+
+#include "glstate.hpp"
+
+std::unordered_map<GLenum, bool> GLState::s_enabled;
+GLenum GLState::s_blend_src = 0;
+GLenum GLState::s_blend_dst = 0;
+GLenum GLState::s_shademodel = 0;
+GLuint GLState::s_program = 0;
+GLuint GLState::s_texture = 0;
+bool GLState::s_blend_known = false;
+bool GLState::s_program_known = false;
+bool GLState::s_texture_known = false;
+std::unordered_map<uint32_t, std::vector<GLfloat>> GLState::s_material;
+std::unordered_map<uint32_t, std::vector<GLfloat>> GLState::s_light;
+std::vector<std::pair<GLbitfield, std::unordered_map<GLenum, bool>>> GLState::s_stack;
+uint32_t GLState::s_skipped = 0;
+uint32_t GLState::s_skipped_last = 0;
+
+/**
+ * \brief glEnable(), unless the capability is known to be enabled
+ * \param cap The capability, e.g. GL_DEPTH_TEST
+ */
+void GLState::enable(GLenum cap)
+{
+	auto state = s_enabled.find(cap);
+	if (state != s_enabled.end() && state->second)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glEnable(cap);
+	s_enabled[cap] = true;
+}
+
+/**
+ * \brief glDisable(), unless the capability is known to be disabled
+ * \param cap The capability, e.g. GL_DEPTH_TEST
+ */
+void GLState::disable(GLenum cap)
+{
+	auto state = s_enabled.find(cap);
+	if (state != s_enabled.end() && !state->second)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glDisable(cap);
+	s_enabled[cap] = false;
+}
+
+/**
+ * \brief glBlendFunc(), unless the factors are set already
+ */
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+	if (s_blend_known && s_blend_src == sfactor && s_blend_dst == dfactor)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glBlendFunc(sfactor, dfactor);
+	s_blend_src = sfactor;
+	s_blend_dst = dfactor;
+	s_blend_known = true;
+}
+
+/**
+ * \brief glShadeModel(), unless the mode is set already
+ */
+void GLState::shadeModel(GLenum mode)
+{
+	if (s_shademodel == mode)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glShadeModel(mode);
+	s_shademodel = mode;
+}
+
+/**
+ * \brief glUseProgram(), unless the program is in use already
+ */
+void GLState::useProgram(GLuint program)
+{
+	if (s_program_known && s_program == program)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glUseProgram(program);
+	s_program = program;
+	s_program_known = true;
+}
+
+/**
+ * \brief glBindTexture() for GL_TEXTURE_2D, unless the texture is bound already
+ */
+void GLState::bindTexture(GLuint texture)
+{
+	if (s_texture_known && s_texture == texture)
+	{
+		s_skipped++;
+		return;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	s_texture = texture;
+	s_texture_known = true;
+}
+
+/**
+ * \brief glDeleteTextures(), deleting the bound texture binds texture 0
+ */
+void GLState::deleteTextures(GLsizei n, const GLuint *textures)
+{
+	glDeleteTextures(n, textures);
+
+	for (GLsizei i = 0; i < n; ++i)
+		if (s_texture_known && s_texture == textures[i])
+			s_texture = 0;
+}
+
+/**
+ * \brief Stores params in the cache, returns false if they were stored already
+ * \param num Number of values in params
+ */
+bool GLState::setParameter(std::unordered_map<uint32_t, std::vector<GLfloat>> &cache,
+	uint32_t key, const GLfloat *params, uint8_t num)
+{
+	std::vector<GLfloat> &cached = cache[key];
+	if (cached.size() == num && memcmp(&cached[0], params, num * sizeof(GLfloat)) == 0)
+		return false;
+
+	cached.assign(params, params + num);
+	return true;
+}
+
+/**
+ * \brief glMaterialfv() for GL_FRONT_AND_BACK, unless the parameter has that value already
+ * \param pname GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR, GL_EMISSION or GL_SHININESS
+ *
+ * GL_AMBIENT and GL_DIFFUSE are always passed on, as GL_COLOR_MATERIAL changes them.
+ */
+void GLState::material(GLenum pname, const GLfloat *params)
+{
+	if (pname == GL_AMBIENT || pname == GL_DIFFUSE || pname == GL_AMBIENT_AND_DIFFUSE)
+	{
+		glMaterialfv(GL_FRONT_AND_BACK, pname, params);
+		return;
+	}
+
+	if (!setParameter(s_material, pname, params, pname == GL_SHININESS ? 1 : 4))
+	{
+		s_skipped++;
+		return;
+	}
+
+	glMaterialfv(GL_FRONT_AND_BACK, pname, params);
+}
+
+/**
+ * \brief glMaterialf() for GL_FRONT_AND_BACK, unless the parameter has that value already
+ */
+void GLState::materialf(GLenum pname, GLfloat param)
+{
+	material(pname, &param);
+}
+
+/**
+ * \brief glLightfv(), unless the parameter has that value already
+ *
+ * GL_POSITION and GL_SPOT_DIRECTION are always passed on, as they depend on the modelview
+ * matrix at the time of the call.
+ */
+void GLState::light(GLenum light, GLenum pname, const GLfloat *params)
+{
+	if (pname == GL_POSITION || pname == GL_SPOT_DIRECTION)
+	{
+		glLightfv(light, pname, params);
+		return;
+	}
+
+	uint8_t num = (pname == GL_AMBIENT || pname == GL_DIFFUSE || pname == GL_SPECULAR) ? 4 : 1;
+	if (!setParameter(s_light, (light - GL_LIGHT0) << 16 | pname, params, num))
+	{
+		s_skipped++;
+		return;
+	}
+
+	glLightfv(light, pname, params);
+}
+
+/**
+ * \brief glLightf(), unless the parameter has that value already
+ */
+void GLState::lightf(GLenum light, GLenum pname, GLfloat param)
+{
+	GLState::light(light, pname, &param);
+}
+
+/*
+	Enable bits that glPopAttrib() restores as part of attribute groups other than
+	GL_ENABLE_BIT (evaluators are left out, they are not used)
+*/
+static const std::vector<std::pair<GLbitfield, std::vector<GLenum>>> attrib_group_caps = {
+	{GL_COLOR_BUFFER_BIT, {GL_ALPHA_TEST, GL_BLEND, GL_DITHER, GL_COLOR_LOGIC_OP}},
+	{GL_DEPTH_BUFFER_BIT, {GL_DEPTH_TEST}},
+	{GL_FOG_BIT, {GL_FOG}},
+	{GL_LIGHTING_BIT, {GL_LIGHTING, GL_COLOR_MATERIAL, GL_LIGHT0, GL_LIGHT1, GL_LIGHT2,
+		GL_LIGHT3, GL_LIGHT4, GL_LIGHT5, GL_LIGHT6, GL_LIGHT7}},
+	{GL_LINE_BIT, {GL_LINE_SMOOTH, GL_LINE_STIPPLE}},
+	{GL_MULTISAMPLE_BIT, {GL_MULTISAMPLE, GL_SAMPLE_ALPHA_TO_COVERAGE,
+		GL_SAMPLE_ALPHA_TO_ONE, GL_SAMPLE_COVERAGE}},
+	{GL_POINT_BIT, {GL_POINT_SMOOTH}},
+	{GL_POLYGON_BIT, {GL_CULL_FACE, GL_POLYGON_SMOOTH, GL_POLYGON_STIPPLE,
+		GL_POLYGON_OFFSET_FILL, GL_POLYGON_OFFSET_LINE, GL_POLYGON_OFFSET_POINT}},
+	{GL_SCISSOR_BIT, {GL_SCISSOR_TEST}},
+	{GL_STENCIL_BUFFER_BIT, {GL_STENCIL_TEST}},
+	{GL_TEXTURE_BIT, {GL_TEXTURE_GEN_S, GL_TEXTURE_GEN_T, GL_TEXTURE_GEN_R, GL_TEXTURE_GEN_Q}},
+	{GL_TRANSFORM_BIT, {GL_NORMALIZE, GL_RESCALE_NORMAL, GL_CLIP_PLANE0, GL_CLIP_PLANE1,
+		GL_CLIP_PLANE2, GL_CLIP_PLANE3, GL_CLIP_PLANE4, GL_CLIP_PLANE5}}
+};
+
+/**
+ * \brief glPushAttrib(), remembers the enable bits to restore them in popAttrib()
+ */
+void GLState::pushAttrib(GLbitfield mask)
+{
+	glPushAttrib(mask);
+	s_stack.push_back(std::make_pair(mask, s_enabled));
+}
+
+/**
+ * \brief glPopAttrib(), restores the cache to the state of the corresponding pushAttrib()
+ *
+ * Only the enable bits are restored, also those that belong to other attribute groups than
+ * GL_ENABLE_BIT (e.g. GL_LIGHTING with GL_LIGHTING_BIT). Other state that glPopAttrib()
+ * restores becomes unknown.
+ */
+void GLState::popAttrib()
+{
+	glPopAttrib();
+
+	GLbitfield mask = s_stack.back().first;
+	const std::unordered_map<GLenum, bool> &saved = s_stack.back().second;
+	if (mask & GL_ENABLE_BIT)
+	{
+		s_enabled = saved;
+	}
+	else
+	{
+		// Other groups restore some enable bits as well
+		for (auto &group : attrib_group_caps)
+		{
+			if (!(mask & group.first)) continue;
+
+			for (GLenum cap : group.second)
+			{
+				auto state = saved.find(cap);
+				if (state != saved.end()) s_enabled[cap] = state->second;
+				else s_enabled.erase(cap);
+			}
+		}
+	}
+	s_stack.pop_back();
+
+	if (mask & GL_COLOR_BUFFER_BIT)
+		s_blend_known = false;
+	if (mask & GL_LIGHTING_BIT)
+	{
+		s_shademodel = 0;
+		s_material.clear();
+		s_light.clear();
+	}
+	if (mask & GL_TEXTURE_BIT)
+		s_texture_known = false;
+}
+
+/**
+ * \brief Forgets all cached state, e.g. after it has been changed directly
+ */
+void GLState::invalidate()
+{
+	s_enabled.clear();
+	s_blend_known = false;
+	s_shademodel = 0;
+	s_program_known = false;
+	s_texture_known = false;
+	s_material.clear();
+	s_light.clear();
+}
+
+/**
+ * \brief To be called after every frame, see getSkippedNum()
+ */
+void GLState::endFrame()
+{
+	s_skipped_last = s_skipped;
+	s_skipped = 0;
+}
@@ -0,0 +1,72 @@
+#ifndef _GLSTATE_H
+#define _GLSTATE_H
+
+#include <unordered_map>
+#include <stdint.h>
+#include <vector>
+
+#include "gllibs.hpp"
+
+/**
+ * \brief Remembers OpenGL state, so that calls that would not change it can be skipped
+ *
+ * Covers enable bits, the blend function, the shade model, the program in use, the texture
+ * bound to GL_TEXTURE_2D and the material and light parameters. Values that depend on the
+ * modelview matrix (GL_POSITION of lights) are always passed on. As GL_COLOR_MATERIAL lets
+ * glColor change the ambient and diffuse material, those are passed on as well.
+ *
+ * All changes to this state must go through GLState, otherwise the cache is wrong. Use
+ * pushAttrib() / popAttrib() instead of glPushAttrib() / glPopAttrib(), and invalidate()
+ * after code that changes the state directly.
+ */
+class GLState
+{
+	public:
+		static void enable(GLenum cap);
+		static void disable(GLenum cap);
+		static void blendFunc(GLenum sfactor, GLenum dfactor);
+		static void shadeModel(GLenum mode);
+		static void useProgram(GLuint program);
+		static void bindTexture(GLuint texture);
+		static void deleteTextures(GLsizei n, const GLuint *textures);
+		static void material(GLenum pname, const GLfloat *params);
+		static void materialf(GLenum pname, GLfloat param);
+		static void light(GLenum light, GLenum pname, const GLfloat *params);
+		static void lightf(GLenum light, GLenum pname, GLfloat param);
+
+		static void pushAttrib(GLbitfield mask);
+		static void popAttrib();
+		static void invalidate();
+
+		/// Forgets the bound texture, e.g. after SOIL has loaded (and bound) a texture
+		static void forgetTexture()
+			{ s_texture_known = false; }
+
+		static void endFrame();
+
+		/// Number of calls that have been skipped during the last frame
+		static uint32_t getSkippedNum()
+			{ return s_skipped_last; }
+
+	private:
+		static bool setParameter(std::unordered_map<uint32_t, std::vector<GLfloat>> &cache,
+			uint32_t key, const GLfloat *params, uint8_t num);
+
+		// Cached state, missing entries are unknown
+		static std::unordered_map<GLenum, bool> s_enabled;
+		static GLenum s_blend_src, s_blend_dst;
+		static GLenum s_shademodel;	// 0 if unknown
+		static GLuint s_program;
+		static GLuint s_texture;
+		static bool s_blend_known, s_program_known, s_texture_known;
+		static std::unordered_map<uint32_t, std::vector<GLfloat>> s_material;
+		static std::unordered_map<uint32_t, std::vector<GLfloat>> s_light;
+
+		// Masks and enable bits saved by pushAttrib()
+		static std::vector<std::pair<GLbitfield, std::unordered_map<GLenum, bool>>> s_stack;
+
+		static uint32_t s_skipped;
+		static uint32_t s_skipped_last;
+};
+
+#endif
@@ -7,18 +7,18 @@
 
 /**
  * \brief Create a new GravityManager for objects
- * \param objects All objects in the WorldEnvironment
+ * \param entities The EntityStore of the WorldEnvironment, all entities with a MassComponent
+ * must also have a TransformComponent
  */
-GravityManager::GravityManager(std::vector<WorldObject*>* objects)
+GravityManager::GravityManager(EntityStore &entities)
 {
 	// Copy environment so that the order in which planetary movement is called won't matter
 	// as we always use the inital environment for acceleration calculations
-	for (auto obj : *objects)
-	{
-		MassObject *obj_m = dynamic_cast<MassObject *>(obj);
-		if (obj_m) // only if object is a MassObject
-			m_objects.push_back(GravObject(obj->getPos(), obj_m->getMass()));
-	}
+	std::vector<MassComponent> &masses = entities.getMasses().getComponents();
+	const std::vector<Entity> &owners = entities.getMasses().getEntities();
+	for (size_t i = 0; i < masses.size(); i++)
+		m_objects.push_back(GravObject(entities.getTransforms().get(owners[i]).pos,
+			masses[i].mass));
 }
 
 GravityManager::~GravityManager()
@@ -2,10 +2,9 @@
 #define _GRAVITY_H
 
 #include <vector>
+#include "environment.hpp"
 #include "util.hpp"
 
-class WorldObject;
-
 /// Object that causes a gravitational force, helper class for GravityManager
 class GravObject
 {
@@ -20,7 +19,7 @@ class GravObject
 class GravityManager
 {
 	public:
-		GravityManager(std::vector<WorldObject*>* objects);
+		GravityManager(EntityStore &entities);
 		~GravityManager();
 		SimpleVec3d getGravityAcc(SimpleVec3d  pos);
 
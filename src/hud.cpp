@@ -9,6 +9,7 @@
 #include "drawutil.hpp"
 #include "teleport.hpp"
 #include "objects.hpp"
+#include "glstate.hpp"
 #include "camera.hpp"
 #include "player.hpp"
 #include "gllibs.hpp"
@@ -116,28 +117,24 @@ void PlanetLocator::whileWorldMatrix(int window_w, int window_h)
 	if (m_hidden) return;
 	m_labels.clear();
 
-	for (auto obj : game->getWorldEnv()->getObjects())
+	for (auto &target : game->getWorldEnv()->getTeleportTargets())
 	{
-		TeleportTarget *planet = dynamic_cast<TeleportTarget*>(obj);
-		if (planet)
-		{
-			// Get ModelViewMatrix + Projectionmatrix + Viewport
-			glm::mat4x4 modelview, proj;
-			glm::ivec4 viewport;
-			glGetFloatv(GL_MODELVIEW_MATRIX, &modelview[0][0]);
-			glGetFloatv(GL_PROJECTION_MATRIX, &proj[0][0]);
-			glGetIntegerv(GL_VIEWPORT, &viewport[0]);
-
-			// Calculate label position on screen (2d pos)
-			SimpleVec3d diffvec = obj->getPos() - game->getPlayer()->getPos();
-			glm::vec3 center = glm::project(diffvec.normalize().toVec3(),
-				modelview, proj, viewport);
-
-			glm::vec2 labelpos;
-			labelpos.x = 2.0f * ((float)center.x / (float)window_w) - 1;
-			labelpos.y = 2.0f * ((float)center.y / (float)window_h) - 1;
-			if (center.z < 1) m_labels[planet->getTeleportName()] = labelpos;
-		}
+		// Get ModelViewMatrix + Projectionmatrix + Viewport
+		glm::mat4x4 modelview, proj;
+		glm::ivec4 viewport;
+		glGetFloatv(GL_MODELVIEW_MATRIX, &modelview[0][0]);
+		glGetFloatv(GL_PROJECTION_MATRIX, &proj[0][0]);
+		glGetIntegerv(GL_VIEWPORT, &viewport[0]);
+
+		// Calculate label position on screen (2d pos)
+		SimpleVec3d diffvec = target.obj->getPos() - game->getPlayer()->getPos();
+		glm::vec3 center = glm::project(diffvec.normalize().toVec3(),
+			modelview, proj, viewport);
+
+		glm::vec2 labelpos;
+		labelpos.x = 2.0f * ((float)center.x / (float)window_w) - 1;
+		labelpos.y = 2.0f * ((float)center.y / (float)window_h) - 1;
+		if (center.z < 1) m_labels[target.iface->getTeleportName()] = labelpos;
 	}
 }
 
@@ -403,11 +400,10 @@ void TeleportWindow::render(int window_w, int window_h)
 
 	glColor3f(1, 1, 1);
 	// Render preview of TeleportTarget
-	glPushAttrib(GL_ENABLE_BIT);
+	GLState::pushAttrib(GL_ENABLE_BIT);
 	{
-		glEnable (GL_DEPTH);
-		glEnable (GL_DEPTH_TEST);
-		glEnable (GL_BLEND);
+		GLState::enable (GL_DEPTH_TEST);
+		GLState::enable (GL_BLEND);
 
 		glScalef(1.0f / apsr, 1.0f, 1.0f);
 
@@ -444,7 +440,7 @@ void TeleportWindow::render(int window_w, int window_h)
 			}
 		}
 	}
-	glPopAttrib();
+	GLState::popAttrib();
 }
 
 void TeleportWindow::onKeyPress_wrapper (unsigned char key, void *self)
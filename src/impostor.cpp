@@ -0,0 +1,167 @@
+#include <math.h>
+
+#include "lightregistry.hpp"
+#include "impostor.hpp"
+#include "glstate.hpp"
+
+// Refresh the picture when the view or light direction changes by more than this (degrees)
+#define IMPOSTOR_MAX_ANGLE 2.0
+
+// Texture resolution bounds, the resolution follows the size on the screen in between
+#define IMPOSTOR_MIN_RESOLUTION 4
+#define IMPOSTOR_MAX_RESOLUTION 64
+
+// Bodies smaller than this on the screen (in pixels) are enlarged, so that they stay visible
+#define IMPOSTOR_MIN_PIXELS 2.0
+
+/// Creates an empty Impostor, OpenGL objects are created by the first beginCapture()
+Impostor::Impostor() :
+m_resolution(0)
+{
+}
+
+/**
+ * \brief Returns the texture resolution for a body of the given size on the screen
+ * \param pixels The diameter of the body on the screen in pixels
+ */
+uint16_t Impostor::getResolution(float pixels)
+{
+	uint16_t resolution = IMPOSTOR_MIN_RESOLUTION;
+	while (resolution < pixels && resolution < IMPOSTOR_MAX_RESOLUTION)
+		resolution *= 2;
+	return resolution;
+}
+
+/**
+ * \brief Returns true if the picture has to be captured (again)
+ * \param viewdir Normalized direction from the body to the player
+ * \param lightdir Normalized direction from the body to the light
+ * \param pixels The diameter of the body on the screen in pixels
+ */
+bool Impostor::needsUpdate(SimpleVec3d viewdir, SimpleVec3d lightdir, float pixels)
+{
+	if (m_resolution != getResolution(pixels)) return true;
+
+	double mincos = cos(IMPOSTOR_MAX_ANGLE * M_PI / 180);
+	return dotProduct(viewdir, m_viewdir) < mincos || dotProduct(lightdir, m_lightdir) < mincos;
+}
+
+/**
+ * \brief Redirects rendering into the texture of the Impostor
+ * \param radius The radius of the body, the picture covers -radius ... radius
+ * \param viewdir Normalized direction from the body to the player
+ * \param lightdir Normalized direction from the body to the light
+ * \param pixels The diameter of the body on the screen in pixels
+ *
+ * Afterwards, the body is to be rendered at the origin with its shader, as the modelview
+ * matrix looks at it from viewdir and the first light of the LightRegistry comes from
+ * lightdir. endCapture() must be called when done.
+ */
+void Impostor::beginCapture(float radius, SimpleVec3d viewdir, SimpleVec3d lightdir,
+	float pixels)
+{
+	uint16_t resolution = getResolution(pixels);
+
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_prev_fbo);
+	if (resolution != m_resolution)
+	{
+		m_target.resize(resolution, resolution);
+		m_resolution = resolution;
+	}
+	m_target.bind();
+
+	m_viewdir = viewdir;
+	m_lightdir = lightdir;
+	m_right = crossProduct(getVectorPerpendicular(viewdir), viewdir).normalize();
+	m_up = crossProduct(viewdir, m_right);
+
+	glGetIntegerv(GL_VIEWPORT, m_prev_viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, m_prev_clear);
+	glGetLightfv(LIGHT_REGISTRY_FIRST, GL_POSITION, m_prev_lightpos);
+	glGetBooleanv(GL_COLOR_WRITEMASK, m_prev_colormask);
+
+	// In anaglyph mode, only one eye's channels would be written otherwise
+	glColorMask(true, true, true, true);
+	glViewport(0, 0, m_resolution, m_resolution);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(-radius, radius, -radius, radius, radius, radius * 3);
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	SimpleVec3d eye = viewdir * radius * 2;
+	gluLookAt(eye.x, eye.y, eye.z, 0, 0, 0, m_up.x, m_up.y, m_up.z);
+
+	// The light only needs the right direction, its distance is irrelevant at this scale
+	SimpleVec3d light = lightdir * radius * 1000;
+	GLfloat lightpos[] = {(float)light.x, (float)light.y, (float)light.z, 1.0};
+	GLState::light(LIGHT_REGISTRY_FIRST, GL_POSITION, lightpos);
+}
+
+/**
+ * \brief Restores the framebuffer, matrices, color mask and the light changed by beginCapture()
+ */
+void Impostor::endCapture()
+{
+	// The saved position is in eye coordinates, so it is restored with an identity modelview
+	glLoadIdentity();
+	GLState::light(LIGHT_REGISTRY_FIRST, GL_POSITION, m_prev_lightpos);
+	glPopMatrix();
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_prev_fbo);
+	glViewport(m_prev_viewport[0], m_prev_viewport[1], m_prev_viewport[2], m_prev_viewport[3]);
+	glClearColor(m_prev_clear[0], m_prev_clear[1], m_prev_clear[2], m_prev_clear[3]);
+	glColorMask(m_prev_colormask[0], m_prev_colormask[1], m_prev_colormask[2],
+		m_prev_colormask[3]);
+}
+
+/**
+ * \brief Draws the captured picture as a quad at the origin, facing the player
+ * \param radius The radius of the body
+ * \param pixels The diameter of the body on the screen in pixels
+ *
+ * Unlit, as the lighting is part of the picture. Transparent texels are discarded, so that
+ * only the body itself writes depth. Bodies smaller than IMPOSTOR_MIN_PIXELS are drawn
+ * with that size.
+ */
+void Impostor::render(float radius, float pixels)
+{
+	if (m_resolution == 0) return;
+
+	if (pixels < IMPOSTOR_MIN_PIXELS)
+		radius *= IMPOSTOR_MIN_PIXELS / pixels;
+	SimpleVec3d right = m_right * radius;
+	SimpleVec3d up = m_up * radius;
+	SimpleVec3d corners[] = {right * -1 - up, right - up, right + up, up - right};
+	GLfloat texcoords[][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+	GLState::disable(GL_LIGHTING);
+	GLState::enable(GL_TEXTURE_2D);
+	GLState::bindTexture(m_target.getTexture());
+	glColor4f(1, 1, 1, 1);
+
+	// The corners around the body are transparent, they must not hide what is behind them
+	GLState::enable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0);
+
+	glBegin(GL_QUADS);
+	for (uint8_t i = 0; i < 4; i++)
+	{
+		glTexCoord2fv(texcoords[i]);
+		glVertex3d(corners[i].x, corners[i].y, corners[i].z);
+	}
+	glEnd();
+
+	GLState::disable(GL_ALPHA_TEST);
+	GLState::disable(GL_TEXTURE_2D);
+	GLState::enable(GL_LIGHTING);
+}
@@ -0,0 +1,52 @@
+#ifndef _IMPOSTOR_H
+#define _IMPOSTOR_H
+
+#include <stdint.h>
+
+#include "rendertarget.hpp"
+#include "gllibs.hpp"
+#include "util.hpp"
+
+/**
+ * \brief Cached picture of a distant body, drawn as a single textured quad
+ *
+ * The body renders itself into a texture between beginCapture() and endCapture(), as seen
+ * from the player and lit by the most relevant light. The picture is reused until the
+ * direction to the player or to the light changes by more than IMPOSTOR_MAX_ANGLE or the
+ * body's size on the screen needs a different texture resolution, see needsUpdate().
+ */
+class Impostor
+{
+	public:
+		Impostor();
+
+		bool needsUpdate(SimpleVec3d viewdir, SimpleVec3d lightdir, float pixels);
+		void beginCapture(float radius, SimpleVec3d viewdir, SimpleVec3d lightdir,
+			float pixels);
+		void endCapture();
+
+		void render(float radius, float pixels);
+
+	private:
+		static uint16_t getResolution(float pixels);
+
+		RenderTarget m_target;
+		uint16_t m_resolution;	// 0 until the first capture
+
+		// Directions from the body to the player and to the light at the last capture
+		SimpleVec3d m_viewdir;
+		SimpleVec3d m_lightdir;
+
+		// Axes of the captured picture in world coordinates
+		SimpleVec3d m_right;
+		SimpleVec3d m_up;
+
+		// State restored by endCapture()
+		GLint m_prev_fbo;
+		GLint m_prev_viewport[4];
+		GLfloat m_prev_clear[4];
+		GLboolean m_prev_colormask[4];
+		GLfloat m_prev_lightpos[4];
+};
+
+#endif
@@ -1,17 +1,27 @@
+#include <algorithm>
+#include <math.h>
+
 #include "gllibs.hpp"
+#include "glstate.hpp"
 #include "light.hpp"
 #include "util.hpp"
 
 void LightInformation::render (GLenum lightid)
 {
 	if (m_usefv)
-		glLightfv(lightid, m_type, m_paramfv);
+		GLState::light (lightid, m_type, m_paramfv);
 	else
-		glLightf (lightid, m_type, m_paramf); 
+		GLState::lightf(lightid, m_type, m_paramf);
+}
+
+GLfloat LightInformation::getValue()
+{
+	if (m_usefv)
+		return std::max(m_paramfv[0], std::max(m_paramfv[1], m_paramfv[2]));
+	return m_paramf;
 }
 
 LightSpec::LightSpec () :
-m_lightid(GL_LIGHT0),
 m_enabled(false)
 {
 	clearLightInformation();
@@ -22,23 +32,58 @@ LightSpec::~LightSpec ()
 	clearLightInformation();
 }
 
-void LightSpec::render(SimpleVec3d pos)
+/**
+ * \brief Sets up an OpenGL light with this specification
+ * \param lightid The OpenGL light to use (GL_LIGHT0 ... GL_LIGHT7)
+ * \param pos The position of the light relative to the camera
+ *
+ * The parameters only reach OpenGL if they differ from the ones the light already has.
+ */
+void LightSpec::render(GLenum lightid, SimpleVec3d pos)
 {
-	glEnable(m_lightid);
+	GLState::enable(lightid);
 
 	GLfloat light_pos[] = {(float)pos.x, (float)pos.y, (float)pos.z, 1.0};
-	glLightfv(m_lightid, GL_POSITION, light_pos);
+	GLState::light(lightid, GL_POSITION, light_pos);
 
-	for (auto li : m_lightinf)
-	{
-		li.render(m_lightid);
-	}
+	for (auto &li : m_lightinf)
+		li.render(lightid);
 }
 
-void LightSpec::disable()
+/**
+ * \brief Estimates how bright the light appears at the given distance
+ * \param distance The distance to the light source
+ *
+ * That is the brightest diffuse color component divided by the OpenGL attenuation.
+ */
+double LightSpec::getIntensity(double distance)
 {
-	glDisable(m_lightid);
-	m_enabled = false;
+	double brightness = 0;
+	double constant = 1, linear = 0, quadratic = 0;
+
+	for (auto &li : m_lightinf)
+	{
+		switch (li.getType())
+		{
+			case GL_DIFFUSE:
+				brightness = li.getValue();
+				break;
+			case GL_CONSTANT_ATTENUATION:
+				constant = li.getValue();
+				break;
+			case GL_LINEAR_ATTENUATION:
+				linear = li.getValue();
+				break;
+			case GL_QUADRATIC_ATTENUATION:
+				quadratic = li.getValue();
+				break;
+		}
+	}
+
+	double attenuation = constant + linear * distance + quadratic * distance * distance;
+	if (brightness <= 0) return 0;
+	if (attenuation <= 0) return INFINITY;
+	return brightness / attenuation;
 }
 
 void LightSpec::enable()
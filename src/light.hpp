@@ -25,6 +25,11 @@ class LightInformation
 			}
 		void render(GLenum lightid);
 
+		GLenum getType()
+			{ return m_type; };
+
+		/// The brightest color component for colors, the parameter otherwise
+		GLfloat getValue();
 
 	private:
 		GLenum m_type;			// GL_AMBIENT / GL_DIFFUSE / GL_SPECULAR / ...
@@ -41,10 +46,15 @@ class LightSpec
 		LightSpec();
 		~LightSpec();
 
-		void render(SimpleVec3d m_pos);
-		void disable();
+		void render(GLenum lightid, SimpleVec3d pos);
 		void enable();
 
+		/// True if the light is emitted, only then it may be added to the LightRegistry
+		bool getEnabled()
+			{ return m_enabled; };
+
+		double getIntensity(double distance);
+
 		void addLightInformationfv(GLenum type,  const GLfloat *param);
 		void addLightInformationcolor(GLenum type, SimpleColor color);
 		void addLightInformationf (GLenum type, GLfloat  param);
@@ -52,11 +62,7 @@ class LightSpec
 		void clearLightInformation()
 			{ m_lightinf.clear(); };
 
-		void setLightID(GLenum lightid)
-			{ m_lightid = lightid; };
-
 	private:
 		std::vector<LightInformation> m_lightinf;
-		GLenum m_lightid;
 		bool m_enabled;
 };
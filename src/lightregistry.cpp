@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "lightregistry.hpp"
+#include "glstate.hpp"
+#include "objects.hpp"
+
+/**
+ * \brief Adds a WorldObject whose LightSpec is enabled, e.g. in its constructor
+ * \param emitter The WorldObject that emits light
+ */
+void LightRegistry::addEmitter(WorldObject *emitter)
+{
+	m_emitters.push_back(emitter);
+}
+
+/**
+ * \brief Removes an emitter added by addEmitter(), e.g. when it is destructed
+ * \param emitter The WorldObject that emits light
+ */
+void LightRegistry::removeEmitter(WorldObject *emitter)
+{
+	m_emitters.erase(std::remove(m_emitters.begin(), m_emitters.end(), emitter),
+		m_emitters.end());
+	m_selected.erase(std::remove_if(m_selected.begin(), m_selected.end(),
+		[emitter] (const LightRegistrySlot &slot) { return slot.emitter == emitter; }),
+		m_selected.end());
+}
+
+/**
+ * \brief Chooses the lights for the current frame, to be called once per frame
+ * \param campos The position of the player
+ *
+ * Emitters are ranked by LightSpec::getIntensity() at the player's position.
+ */
+void LightRegistry::select(SimpleVec3d campos)
+{
+	std::vector<std::pair<double, LightRegistrySlot>> ranking;
+	for (auto emitter : m_emitters)
+	{
+		SimpleVec3d relpos = emitter->getPos() - campos;
+		double intensity = emitter->getLightSpec().getIntensity(getVectorLength(relpos));
+		ranking.push_back(std::make_pair(intensity, LightRegistrySlot { emitter, relpos }));
+	}
+
+	uint8_t num = std::min<size_t>(ranking.size(), LIGHT_REGISTRY_SLOTS);
+	std::partial_sort(ranking.begin(), ranking.begin() + num, ranking.end(),
+		[] (const std::pair<double, LightRegistrySlot> &a,
+			const std::pair<double, LightRegistrySlot> &b)
+		{ return a.first > b.first; });
+
+	m_selected.clear();
+	for (uint8_t i = 0; i < num; i++)
+		m_selected.push_back(ranking[i].second);
+}
+
+/**
+ * \brief Sets up the OpenGL lights chosen by select(), once for every eye
+ *
+ * The positions depend on the modelview matrix and are always passed on, the other
+ * parameters only reach OpenGL when the assignment of the lights has changed.
+ */
+void LightRegistry::render()
+{
+	for (uint8_t i = 0; i < LIGHT_REGISTRY_SLOTS; i++)
+	{
+		if (i < m_selected.size())
+			m_selected[i].emitter->getLightSpec().render(LIGHT_REGISTRY_FIRST + i,
+				m_selected[i].relpos);
+		else
+			GLState::disable(LIGHT_REGISTRY_FIRST + i);
+	}
+}
+
+/// Disables the OpenGL lights used by render()
+void LightRegistry::disable()
+{
+	for (uint8_t i = 0; i < LIGHT_REGISTRY_SLOTS; i++)
+		GLState::disable(LIGHT_REGISTRY_FIRST + i);
+}
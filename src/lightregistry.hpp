@@ -0,0 +1,49 @@
+#ifndef _LIGHTREGISTRY_H
+#define _LIGHTREGISTRY_H
+
+#include <vector>
+
+#include "gllibs.hpp"
+#include "util.hpp"
+
+class WorldObject;
+
+// The OpenGL lights used by the LightRegistry; shaders use the first one (SUNLIGHT_ID)
+#define LIGHT_REGISTRY_FIRST GL_LIGHT1
+#define LIGHT_REGISTRY_SLOTS 4
+
+/// A light selected by the LightRegistry for the current frame
+struct LightRegistrySlot
+{
+	WorldObject *emitter;
+	SimpleVec3d relpos;	// position relative to the player
+};
+
+/**
+ * \brief Keeps track of the WorldObjects that emit light
+ *
+ * Only emitters (the Stars) register here, so the Camera does not have to look at the
+ * LightSpec of every object. Once per frame, the LIGHT_REGISTRY_SLOTS most relevant
+ * lights are chosen and assigned to the OpenGL lights starting at LIGHT_REGISTRY_FIRST,
+ * the most relevant one first.
+ */
+class LightRegistry
+{
+	public:
+		void addEmitter(WorldObject *emitter);
+		void removeEmitter(WorldObject *emitter);
+
+		void select(SimpleVec3d campos);
+		void render();
+		void disable();
+
+		/// The emitter of the most relevant light, nullptr if there is none
+		WorldObject *getMainEmitter()
+			{ return m_selected.empty() ? nullptr : m_selected[0].emitter; }
+
+	private:
+		std::vector<WorldObject *> m_emitters;
+		std::vector<LightRegistrySlot> m_selected;
+};
+
+#endif
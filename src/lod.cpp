@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <string>
+#include <math.h>
+
+#include "gamevars.hpp"
+#include "config.hpp"
+#include "lod.hpp"
+
+// Initial viewport height, until the Camera reports the actual one
+#define LOD_DEFAULT_HEIGHT 600
+
+// Field of view in degrees, until the Camera reports the actual one
+#define LOD_DEFAULT_FOV 45
+
+/*
+	If the vertex number drops below LOD_BUDGET_LOW * budget while the tolerance is raised,
+	the tolerance is lowered so that LOD_BUDGET_TARGET * budget vertices are expected.
+	The gap between both prevents the detail from toggling between two states.
+*/
+#define LOD_BUDGET_LOW 0.6
+#define LOD_BUDGET_TARGET 0.8
+
+/**
+ * \brief Creates the LodManager with the tolerance and budget from the configuration
+ */
+LodManager::LodManager() :
+m_pixel_error(config->getDouble("lod_pixel_error", 4.0)),
+m_budget(config->getInt("lod_vertex_budget", 1500000)),
+m_budget_scale(1.0),
+m_vertexnum(0)
+{
+	setViewport(LOD_DEFAULT_HEIGHT, LOD_DEFAULT_FOV);
+}
+
+/**
+ * \brief Updates the projection the errors are measured with
+ * \param height The height of the viewport in pixels
+ * \param fov The vertical field of view in degrees
+ */
+void LodManager::setViewport(int height, float fov)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_projection = height / (2 * tan(fov / 2 * M_PI / 180));
+}
+
+/**
+ * \brief Returns the distance below which a geometric error becomes visible
+ * \param error The geometric error in simulation units
+ *
+ * If the camera is closer than this distance to a part of a body, that part should be
+ * drawn in more detail. The distance is proportional to the error.
+ */
+double LodManager::getLodDistance(double error)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return error * m_projection / (m_pixel_error * m_budget_scale);
+}
+
+/**
+ * \brief Returns how many pixels an object covers on the screen
+ * \param size The size of the object in simulation units
+ * \param distance The distance to the object in simulation units
+ */
+double LodManager::getPixelSize(double size, double distance)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return size * m_projection / distance;
+}
+
+/**
+ * \brief Reports the number of vertices a body uses for the current level of detail
+ * \param body Any pointer that identifies the body
+ * \param vertexnum The number of vertices
+ *
+ * Takes effect on the distances returned by subsequent calls to getLodDistance().
+ */
+void LodManager::reportVertices(const void *body, uint32_t vertexnum)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_vertexnums[body] = std::make_pair(vertexnum, m_budget_scale);
+	updateBudgetScale();
+}
+
+/**
+ * \brief Removes a body reported by reportVertices(), e.g. when it is destructed
+ * \param body The pointer that identifies the body
+ */
+void LodManager::removeBody(const void *body)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_vertexnums.erase(body);
+	updateBudgetScale();
+}
+
+/// Returns the sum of the vertices of all reported bodies
+uint32_t LodManager::getVertexNum()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_vertexnum;
+}
+
+/**
+ * \brief Adapts the pixel tolerance to the vertex budget, m_mutex must be locked
+ *
+ * The visible detail is refined within a distance proportional to the inverse tolerance,
+ * so the number of vertices of a surface roughly scales with the inverse squared tolerance.
+ * Bodies that have not been refined since the last change still report vertices for an
+ * older scale, so every count is converted to the current scale first. Otherwise, each of
+ * these reports would raise the scale again for the same excess.
+ */
+void LodManager::updateBudgetScale()
+{
+	// Vertices expected at scale s: weighted / s^2
+	double weighted = 0;
+	m_vertexnum = 0;
+	for (auto &body : m_vertexnums)
+	{
+		m_vertexnum += body.second.first;
+		weighted += body.second.first * body.second.second * body.second.second;
+	}
+
+	if (m_budget == 0) return;
+
+	double expected = weighted / (m_budget_scale * m_budget_scale);
+	if (expected > m_budget)
+	{
+		m_budget_scale = sqrt(weighted / m_budget);
+	}
+	else if (expected < m_budget * LOD_BUDGET_LOW && m_budget_scale > 1.0)
+	{
+		double scale = sqrt(weighted / (m_budget * LOD_BUDGET_TARGET));
+		m_budget_scale = std::max(1.0, scale);
+	}
+}
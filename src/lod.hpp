@@ -0,0 +1,54 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stdint.h>
+#include <utility>
+#include <mutex>
+#include <map>
+
+/**
+ * \brief Decides how detailed celestial bodies are drawn, shared by all LOD threads
+ *
+ * Geometry is refined where its geometric error (the deviation from the next finer level,
+ * in simulation units) would appear larger than lod_pixel_error pixels on the screen. The
+ * projection depends on the window height and the field of view, which the Camera sets
+ * every frame.
+ *
+ * Every body reports the number of vertices it currently uses. If the total exceeds
+ * lod_vertex_budget, the pixel tolerance is raised for all bodies until it fits again.
+ */
+class LodManager
+{
+	public:
+		LodManager();
+
+		void setViewport(int height, float fov);
+
+		double getLodDistance(double error);
+		double getPixelSize(double size, double distance);
+
+		void reportVertices(const void *body, uint32_t vertexnum);
+		void removeBody(const void *body);
+
+		uint32_t getVertexNum();
+
+	private:
+		void updateBudgetScale();
+
+		std::mutex m_mutex;
+
+		float m_pixel_error;	// configured tolerance in pixels
+		uint32_t m_budget;	// configured maximum number of vertices of all bodies
+
+		// Pixels that an object of size 1 at a distance of 1 covers on the screen
+		double m_projection;
+
+		// Factor for m_pixel_error, > 1 while the vertex budget is exceeded
+		double m_budget_scale;
+
+		// Reported vertices of every body and the m_budget_scale they were built with
+		std::map<const void *, std::pair<uint32_t, double>> m_vertexnums;
+		uint32_t m_vertexnum;
+};
+
+#endif
@@ -10,7 +10,9 @@
 #include "keyboard.hpp"
 #include "splash.hpp"
 #include "camera.hpp"
+#include "framepacer.hpp"
 #include "config.hpp"
+#include "ecs.hpp"
 #include "mouse.hpp"
 #include "main.hpp"
 #include "game.hpp"
@@ -19,10 +21,17 @@
  * \brief Main function - starts the game
  *
  * Starts up ConfigurationManager, KeyBoard, Mouse and the game itself. Calls
- * initWindow to initialize the GLUT window.
+ * initWindow to initialize the GLUT window. With --benchmark-ecs, only runs
+ * benchmarkEntities() instead.
  */
 int main(int argc, char **argv)
 {
+	if (argc > 1 && std::string(argv[1]) == "--benchmark-ecs")
+	{
+		benchmarkEntities();
+		return 0;
+	}
+
 	std::cout<<"Starting the Game!"<<std::endl;
 #ifdef PLANETHER_WINDOWS
 	std::cout<<"###########################"<<std::endl;
@@ -91,6 +100,7 @@ void initWindow(int argc, char **argv)
 #endif
 	glutMouseFunc		(onMouseClick);
 	glutReshapeFunc		(onReshape);
+	glutVisibilityFunc	(onVisibility);
 }
 
 /**
@@ -175,3 +185,8 @@ void onReshape(int width, int height)
 {
 	game->getStaticEnv()->reshape(width, height);
 }
+
+void onVisibility(int state)
+{
+	game->getFramePacer()->setVisible(state == GLUT_VISIBLE);
+}
@@ -30,5 +30,6 @@ void onKeyRelease(unsigned char key, int x, int y);
 void onSpecialKeyPress(int key, int x, int y);
 void onSpecialKeyRelease(int key, int x, int y);
 void onReshape(int width, int height);
+void onVisibility(int state);
 
 #endif
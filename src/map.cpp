@@ -1,5 +1,6 @@
 #include "gllibs.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <math.h>
@@ -9,7 +10,9 @@
 #include "environment.hpp"
 #include "spaceship.hpp"
 #include "keyboard.hpp"
+#include "cubesphere.hpp"
 #include "drawutil.hpp"
+#include "mesh.hpp"
 #include "gamevars.hpp"
 #include "player.hpp"
 #include "shader.hpp"
@@ -18,6 +21,38 @@
 #include "game.hpp"
 #include "util.hpp"
 #include "map.hpp"
+#include "lightregistry.hpp"
+#include "rendertarget.hpp"
+#include "impostor.hpp"
+#include "lod.hpp"
+
+// Maximum height of the terrain generated by the planet shaders, relative to the radius
+#define PLANET_TERRAIN_AMPLITUDE 0.15
+
+// Number of children (yaw and pitch) of a Star, which are refined when getting closer
+#define STAR_BASE_CHILDREN 10
+
+// Maximum height of the surface noise of the star shaders, relative to the radius
+#define STAR_SURFACE_AMPLITUDE 0.02
+
+// The corona is moved towards the player by distance * radius / STAR_CORONA_SHIFT
+#define STAR_CORONA_SHIFT 40000.0
+
+/*
+	Beyond this distance (in radii), planets are drawn as Impostors; without Impostor support,
+	planets are not drawn beyond PLANET_MAX_DISTANCE radii
+*/
+#define BODY_IMPOSTOR_DISTANCE 100
+#define PLANET_MAX_DISTANCE 1000
+
+// Stars smaller than this on the screen (diameter in pixels) are only drawn as their corona
+#define STAR_SPHERE_MIN_PIXELS 4
+
+// Slices and stacks of the sphere that is rendered into the Impostor of a planet
+#define PLANET_IMPOSTOR_SLICES 24
+
+// Universe time in seconds after which the ring asteroid orbits are uploaded again
+#define RING_EPOCH_INTERVAL 1000.
 
 // Returns position of the earth
 SimpleVec3d initUniverse(WorldEnvironment *w_env)
@@ -122,22 +157,29 @@ SimpleVec3d initUniverse(WorldEnvironment *w_env)
 
 Star::Star(float radius, SimpleVec3d pos, SimpleColor color, double mass, std::string name) :
 PhysicalObject(),
+m_upd_det_running(false),
 m_radius(radius),
 m_color(color),
 m_name(name),
-m_farmode(true)
+m_surface_shader(name),
+m_corona_shader("corona"),
+m_corona_radius_slot(SHADER_NO_SLOT)
 {
 	m_pos = pos;
 	m_mass = mass;
+	m_shader = m_name;
+	m_material = MATERIAL_EMISSIVE;
+	m_translucent = true; // corona is blended
 	m_light.enable();
-	m_light.setLightID(GL_LIGHT1);
 	m_light.addLightInformationcolor(GL_DIFFUSE, m_color);
 	m_light.addLightInformationcolor(GL_SPECULAR, m_color);
 	m_light.addLightInformationf(GL_CONSTANT_ATTENUATION,	0			);
 	m_light.addLightInformationf(GL_LINEAR_ATTENUATION,	0.000000004 / USC	);
 	m_light.addLightInformationf(GL_QUADRATIC_ATTENUATION,	0			);
-	m_sphere = SphereFraction::makePrototype(m_radius, 5, 5);
-	m_sphere->setChildrenStatic(false);
+	game->getLightRegistry()->addEmitter(this);
+	m_sphere = SphereFraction::makePrototype(m_radius, STAR_BASE_CHILDREN, STAR_BASE_CHILDREN);
+	m_upd_det_running = true;
+	m_upd_det_thread = std::thread(&Star::updateDetailThread, this);
 
 	// Generate corona vertices + indices
 	m_corona_vertices[0][0] = -m_radius * 3;
@@ -161,28 +203,38 @@ Star::~Star()
 {
 	std::cout<<"~"<<m_name<<std::endl;
 
+	m_upd_det_running = false;
+	m_upd_det_thread.join();
+
+	game->getLodManager()->removeBody(this);
+	game->getLightRegistry()->removeEmitter(this);
 	delete m_sphere;
 }
 
 void Star::render ()
 {
-	// Sphere
-	game->getCamera()->getShaderManager()->requestShader(m_name);
+	// Sphere (shader m_name is already active), when it is just a few pixels the corona is enough
 	m_color.set();
 	m_color.setEmission();
-	m_sphere->render(); // don't use glutSolidSphere as SphereFractions are way faster
+	double player_distance = getVectorLength(game->getPlayer()->getPos() - m_pos);
+	double pixels = game->getLodManager()->getPixelSize(m_radius * 2, player_distance);
+	if (pixels >= STAR_SPHERE_MIN_PIXELS)
+		m_sphere->render(); // don't use glutSolidSphere as SphereFractions are way faster
 
 	// Corona
 	// in front of sun, facing the player
 	SimpleVec3d dirvec = (game->getPlayer()->getPos() - m_pos).normalize();
 
 	// move corona away from sun when player is very far away (prevents depthtest errors)
-	float distance = getVectorLength(game->getPlayer()->getPos() - m_pos) * m_radius / 40000.0;
+	float distance = player_distance * m_radius / STAR_CORONA_SHIFT;
 	(dirvec * (m_radius + distance)).translate();
 
+	if (m_corona_shader.resolve())
+		m_corona_radius_slot = m_corona_shader->getUniformSlot("radius");
+
 	game->getCamera()->getShaderManager()->resetShader();
-	game->getCamera()->getShaderManager()->getShader("corona")->addParameterf("radius", m_radius);
-	game->getCamera()->getShaderManager()->requestShader("corona");
+	m_corona_shader->setUniformf(m_corona_radius_slot, m_radius);
+	m_corona_shader.request();
 
 	glm::quat coronaquat = RotationBetweenVectors(SimpleVec3d(0, 0, -1), dirvec);
 	glMultMatrixf(glm::value_ptr(glm::toMat4(coronaquat)));
@@ -201,7 +253,7 @@ void Star::renderPreview(float time, float scale)
 	glScalef(scale / m_radius, scale / m_radius, scale / m_radius);
 
 	// Shader Parameter to disable lighting
-	game->getCamera()->getShaderManager()->requestShader(m_name);
+	m_surface_shader.request();
 	glRotatef(time * TELEPORT_PREVIEW_ROTSPEED, 0, 1, 0);
 
 	glutSolidSphere(m_radius, 50, 50);
@@ -209,22 +261,6 @@ void Star::renderPreview(float time, float scale)
 
 void Star::step (float dtime)
 {
-	float dist_to_player = getVectorLength(game->getPlayer()->getPos() - m_pos);
-
-	if (dist_to_player > m_radius * 50 && !m_farmode)
-	{ // decrease detail level
-		m_sphere->setChildren(10, 10);
-		m_sphere->updateVertices();
-		m_farmode = true;
-	}
-
-	if (dist_to_player < m_radius * 49 && m_farmode)
-	{ // increase detail level
-		m_sphere->setChildren(250, 250);
-		m_sphere->updateVertices();
-		m_farmode = false;
-	}
-
 	physicalMove(dtime);
 
 	// Lose when colliding with a star
@@ -232,6 +268,24 @@ void Star::step (float dtime)
 		game->triggerLose();
 }
 
+void Star::updateDetailThread()
+{
+	while(m_upd_det_running)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+		if (game == NULL) continue; // not yet initialized
+
+		SimpleVec3d position_relative = game->getPlayer()->getPos() - m_pos;
+		if (m_sphere->autoChildrenNum(position_relative, STAR_SURFACE_AMPLITUDE))
+		{
+			m_sphere->updateVertices();
+			game->getLodManager()->reportVertices(this,
+				m_sphere->getMeshStats().vertices_after);
+		}
+	}
+}
+
 // Planet Teleport Capabilities
 std::string Star::getTeleportName  ()
 {
@@ -249,6 +303,19 @@ SimpleAngles Star::getTeleportAngles()
 	return SimpleAngles(SimpleVec3d(1, 0, 0));
 }
 
+// Star occlusion culling: the corona quad (3 radii from its center to the edges) is moved
+// towards the player, see render()
+double Star::getBoundingRadius()
+{
+	double distance = getVectorLength(game->getPlayer()->getPos() - m_pos);
+	return m_radius + distance * m_radius / STAR_CORONA_SHIFT + m_radius * 3 * M_SQRT2;
+}
+
+double Star::getOccluderRadius()
+{
+	return m_radius * (1 - STAR_SURFACE_AMPLITUDE);
+}
+
 /*
 	Planet
 */
@@ -277,21 +344,31 @@ Planet::Planet(	float radius, SimpleVec3d pos, SimpleVec3d gravcen, double mass,
 PhysicalObject(),
 m_upd_det_running(false),
 m_radius(radius),
+m_pgensphere(NULL),
+m_cubesphere(NULL),
 m_rotaxis(rotaxis),
 m_rotspeed(rotspeed),
 m_time(0),
 m_name(name),
+m_surface_shader(name),
+m_preview_slot(SHADER_NO_SLOT),
+m_morph_start_slot(SHADER_NO_SLOT),
+m_morph_end_slot(SHADER_NO_SLOT),
 m_ring(ring)
 {
 	m_mass = mass;
 	m_pos = pos;
 	m_velocity = vel;
+	m_shader = m_name;
 
 	// Handle auto-generation of children: Either spawn a updateDetailThread or generate a
 	// Sphere with constant number of vertices.
 	if (const_vertexnum == -1) // automatic vertex number
 	{
-		m_pgensphere = SphereFraction::makePrototype(m_radius, 30, 30);
+		if (config->getBool("cubesphere_planets", true))
+			m_cubesphere = new CubeSphere(m_radius, PLANET_TERRAIN_AMPLITUDE);
+		else
+			m_pgensphere = SphereFraction::makePrototype(m_radius, 30, 30);
 		m_upd_det_running = true;
 		m_upd_det_thread = std::thread(&Planet::updateDetailThread, this);
 	}
@@ -301,6 +378,8 @@ m_ring(ring)
 			const_vertexnum, const_vertexnum);
 	}
 
+	if (m_pgensphere != NULL) m_pgensphere->printMeshStats(m_name);
+
 	if (config->getBool("prerotate_planets", false))
 	{
 		// Pre-rotate the planet around its mass center
@@ -319,26 +398,104 @@ Planet::~Planet()
 	{
 		m_upd_det_running = false;
 		m_upd_det_thread.join();
+		game->getLodManager()->removeBody(this);
 	}
 
 	delete m_ring;
 	delete m_pgensphere;
+	delete m_cubesphere;
 }
 
 void Planet::render ()
 {
+	SimpleVec3d relpos = m_pos - game->getPlayer()->getPos();
+	double distance = getVectorLength(relpos);
+
+	if (RenderTarget::isSupported())
+	{
+		if (distance > m_radius * BODY_IMPOSTOR_DISTANCE)
+		{
+			renderImpostor(relpos, distance);
+			return;
+		}
+	}
 	// Do not render planets if they are so far away that they're practically invisible
-	if (getVectorLength(game->getPlayer()->getPos() - m_pos) > m_radius * 1000) return;
+	else if (distance > m_radius * PLANET_MAX_DISTANCE) return;
 
 	// First render the ring while shader is not loaded
 	if (m_ring != nullptr) m_ring->render();
 
 	// Use lighting - this is no preview
-	game->getCamera()->getShaderManager()->getShader(m_name)->addParameteri("preview", 0);
-	game->getCamera()->getShaderManager()->requestShader(m_name);
+	requestSurfaceShader(0);
 
 	glRotatef(RADTODEG(m_time * m_rotspeed), m_rotaxis.x, m_rotaxis.y, m_rotaxis.z);
-	m_pgensphere->render();
+
+	if (m_cubesphere != NULL)
+	{
+		// Camera position in the rotated coordinate system of the planet, for geomorphing
+		SimpleVec3d campos = game->getPlayer()->getPos() - m_pos;
+		campos = campos.rotateBy(m_rotaxis, -m_rotspeed * m_time);
+		m_cubesphere->render(campos, m_surface_shader);
+	}
+	else
+	{
+		m_pgensphere->render();
+	}
+}
+
+/**
+ * \brief Draws the planet as a single quad, for when it is far away
+ * \param relpos The position of the planet relative to the player
+ * \param distance The length of relpos
+ *
+ * The picture on the quad is rendered with the surface shader and reused as long as
+ * Impostor::needsUpdate() allows. Rings are left out.
+ */
+void Planet::renderImpostor(SimpleVec3d relpos, double distance)
+{
+	SimpleVec3d viewdir = relpos * (-1 / distance);
+	SimpleVec3d lightdir = viewdir;
+	WorldObject *light = game->getLightRegistry()->getMainEmitter();
+	if (light != nullptr) lightdir = (light->getPos() - m_pos).normalize();
+	float pixels = game->getLodManager()->getPixelSize(m_radius * 2, distance);
+
+	if (m_impostor.needsUpdate(viewdir, lightdir, pixels))
+	{
+		m_impostor.beginCapture(m_radius, viewdir, lightdir, pixels);
+
+		requestSurfaceShader(0);
+
+		glRotatef(RADTODEG(m_time * m_rotspeed), m_rotaxis.x, m_rotaxis.y, m_rotaxis.z);
+		glutSolidSphere(m_radius, PLANET_IMPOSTOR_SLICES, PLANET_IMPOSTOR_SLICES);
+
+		m_impostor.endCapture();
+	}
+
+	game->getCamera()->getShaderManager()->resetShader();
+	m_impostor.render(m_radius, pixels);
+}
+
+/**
+ * \brief Activates the surface shader for drawing the planet
+ * \param preview Value of the "preview" uniform, 0 for normal lighting
+ *
+ * Geomorphing is switched off, since CubeSphere::render leaves the morph uniforms at the values
+ * of the last patch it drew. Meshes without morph targets would otherwise collapse.
+ * CubeSphere::render sets them again for each of its patches.
+ */
+void Planet::requestSurfaceShader(int preview)
+{
+	if (m_surface_shader.resolve())
+	{
+		m_preview_slot = m_surface_shader->getUniformSlot("preview");
+		m_morph_start_slot = m_surface_shader->getUniformSlot("morph_start");
+		m_morph_end_slot = m_surface_shader->getUniformSlot("morph_end");
+	}
+
+	m_surface_shader->setUniformi(m_preview_slot, preview);
+	m_surface_shader->setUniformf(m_morph_start_slot, 0);
+	m_surface_shader->setUniformf(m_morph_end_slot, 0);
+	m_surface_shader.request();
 }
 
 void Planet::renderPreview(float time, float scale)
@@ -346,8 +503,7 @@ void Planet::renderPreview(float time, float scale)
 	glScalef(scale / m_radius, scale / m_radius, scale / m_radius);
 
 	// Shader Parameter to disable lighting
-	game->getCamera()->getShaderManager()->getShader(m_name)->addParameteri("preview", 2);
-	game->getCamera()->getShaderManager()->requestShader(m_name);
+	requestSurfaceShader(2);
 	glRotatef(time * TELEPORT_PREVIEW_ROTSPEED, m_rotaxis.x, m_rotaxis.y, m_rotaxis.z);
 
 	glutSolidSphere(m_radius, 50, 50);
@@ -359,12 +515,6 @@ void Planet::step (float dtime)
 	physicalMove(dtime);
 	m_time += dtime;
 
-	// only if the player is nearby, step the ring
-	if (getVectorLength(game->getPlayer()->getPos() - m_pos) < m_radius * 1000)
-	{
-		if (m_ring != nullptr) m_ring->step(dtime);
-	}
-
 	// Losing when colliding with planets
 	if (getVectorLength(game->getSpaceship()->getPos() - m_pos) < m_radius)
 		game->triggerLose();
@@ -375,15 +525,28 @@ void Planet::updateDetailThread()
 {
 	while(m_upd_det_running)
 	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(400));
+		// CubeSphere patches are cheap to select and build, so they can follow the camera closer
+		int interval = (m_cubesphere != NULL) ? 100 : 400;
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval));
 
 		if (game == NULL) continue; // not yet initialized
 
 		SimpleVec3d position_relative = game->getPlayer()->getPos() - m_pos;
 		position_relative = position_relative.rotateBy(m_rotaxis, -m_rotspeed * m_time);
 
-		if (m_pgensphere->autoChildrenNum(position_relative, 60.0))
+		if (m_cubesphere != NULL)
+		{
+			if (m_cubesphere->update(position_relative))
+				game->getLodManager()->reportVertices(this,
+					m_cubesphere->getVertexNum());
+		}
+		else if (m_pgensphere->autoChildrenNum(position_relative,
+				PLANET_TERRAIN_AMPLITUDE))
+		{
 			m_pgensphere->updateVertices();
+			game->getLodManager()->reportVertices(this,
+				m_pgensphere->getMeshStats().vertices_after);
+		}
 	}
 }
 
@@ -404,6 +567,19 @@ SimpleAngles Planet::getTeleportAngles()
 	return SimpleAngles(SimpleVec3d(-1, 0, 0));
 }
 
+// Planet occlusion culling: the terrain may be lower or higher than the radius
+double Planet::getBoundingRadius()
+{
+	double radius = m_radius * (1 + PLANET_TERRAIN_AMPLITUDE);
+	if (m_ring != nullptr) radius = std::max(radius, (double)m_ring->getOuterRadius());
+	return radius;
+}
+
+double Planet::getOccluderRadius()
+{
+	return m_radius * (1 - PLANET_TERRAIN_AMPLITUDE);
+}
+
 /*
 	PlanetRing
 */
@@ -411,7 +587,13 @@ PlanetRing::PlanetRing(float radius, float width, float density, float rotspeed_
 	float rotspeed_max, float minsize, float maxsize, float vertical_spread) :
 m_radius(radius),
 m_width(width),
-m_density(density)
+m_density(density),
+m_outer_radius(0),
+m_epoch(0),
+m_mesh(NULL),
+m_instances(NULL),
+m_shader("asteroid"),
+m_time_slot(SHADER_NO_SLOT)
 {
 	for (float inclination = 0; inclination < PI*2; inclination += 1.0 / m_density)
 	{
@@ -423,49 +605,87 @@ m_density(density)
 		asteroid.rotspeed = rotspeed_min
 			+ (rotspeed_max - rotspeed_min) * (1.  * rand() / RAND_MAX);
 		m_asteroids.push_back(asteroid);
-	}
-
-	m_dodecahedron_displist = glGenLists(1);
 
-	glNewList(m_dodecahedron_displist, GL_COMPILE);
-	{
-		glutSolidDodecahedron();
+		m_outer_radius = std::max(m_outer_radius, asteroid.position.radius + asteroid.size);
 	}
-	glEndList();
 }
 
 PlanetRing::~PlanetRing()
 {
 	std::cout<<"~Planet"<<std::endl;
-	glDeleteLists(m_dodecahedron_displist, 1);
+	delete m_mesh;
+	delete m_instances;
 }
 
-void PlanetRing::step(float dtime)
+/**
+ * \brief Uploads the asteroid model to GPU memory
+ *
+ * Must be called while the OpenGL context is current and the asteroid shader is loaded.
+ */
+void PlanetRing::buildMesh()
 {
-	for (std::vector<RingAsteroid>::iterator it = m_asteroids.begin();
-		it != m_asteroids.end(); ++it)
-		it->position.inclination += dtime * it->rotspeed;
+	MeshBuilder builder;
+	builder.addDodecahedron(SimpleVec3d(0, 0, 0), 1);
+	m_mesh = new MeshBuffer(MESH_NORMALS);
+	builder.upload(m_mesh);
+
+	// Per asteroid: radius, inclination at m_epoch, azimuth, rotation speed | size
+	m_shader.resolve();
+	m_time_slot = m_shader->getUniformSlot("ring_time");
+	m_instances = new InstanceBuffer();
+	m_instances->addAttribute(m_shader->getAttribLocation("asteroid_orbit"), 4);
+	m_instances->addAttribute(m_shader->getAttribLocation("asteroid_size"), 1);
 }
 
-void PlanetRing::render()
+/**
+ * \brief Uploads the orbits of all asteroids, with the inclinations they have at a given time
+ * \param epoch The universe time the inclinations are evaluated at
+ *
+ * The inclinations are calculated in double precision and wrapped to [0, 2*PI), so the shader
+ * only has to add rotspeed * (time - epoch), which is precise in float as long as
+ * time - epoch stays small.
+ */
+void PlanetRing::uploadOrbits(double epoch)
 {
-	for (auto asteroid : m_asteroids)
+	std::vector<GLfloat> instances;
+	instances.reserve(m_asteroids.size() * 5);
+	for (auto &asteroid : m_asteroids)
 	{
-		glPushMatrix();
-		{
-			game->getCamera()->getShaderManager()->requestShader("asteroid");
-			game->getCamera()->getShaderManager()->getShader("asteroid")->addParameterf
-				("scale", asteroid.size);
+		double inclination = fmod(asteroid.position.inclination
+			+ (double)asteroid.rotspeed * epoch, PI*2);
+		GLfloat instance[5] = {
+			asteroid.position.radius, (GLfloat)inclination,
+			asteroid.position.azimuth, asteroid.rotspeed, asteroid.size
+		};
+		instances.insert(instances.end(), instance, instance + 5);
+	}
 
-			SimpleVec3d trans = SimpleVec3d(asteroid.position);
-			glTranslatef(trans.x, trans.y, trans.z);
+	m_instances->upload(&instances[0], m_asteroids.size(), GL_DYNAMIC_DRAW);
+	m_epoch = epoch;
+}
 
-			glCallList(m_dodecahedron_displist);
+/**
+ * \brief Draws all asteroids at their positions at the current universe time
+ *
+ * Nothing is calculated while the ring is not drawn. The orbits are only uploaded again when
+ * the universe time has moved more than RING_EPOCH_INTERVAL away from the last upload (e.g.
+ * after time warp), otherwise the asteroids are moved by the shader alone.
+ */
+void PlanetRing::render()
+{
+	if (m_asteroids.empty()) return;
+	if (m_mesh == NULL) buildMesh();
 
-			game->getCamera()->getShaderManager()->resetShader();
-		}
-		glPopMatrix();
-	}
+	double time = game->getUniverseTime();
+	if (m_instances->getInstanceNum() == 0 || fabs(time - m_epoch) > RING_EPOCH_INTERVAL)
+		uploadOrbits(time);
+
+	m_shader->setUniformf(m_time_slot, time - m_epoch);
+	m_shader.request();
+
+	m_mesh->renderInstanced(GL_TRIANGLES, m_instances);
+
+	game->getCamera()->getShaderManager()->resetShader();
 }
 
 /*
@@ -473,14 +693,20 @@ void PlanetRing::render()
 */
 
 TestGrid::TestGrid() :
-m_draw(false)
+m_draw(false),
+m_mesh(NULL),
+m_instances(NULL)
 {
+	m_shader = "testgrid";
+	m_material = MATERIAL_EMISSIVE;
 	keyboard->registerKeyPressCallback(TestGrid::onKeyboard, this);
 }
 
 TestGrid::~TestGrid()
 {
 	std::cout<<"~TestGrid"<<std::endl;
+	delete m_mesh;
+	delete m_instances;
 }
 
 void TestGrid::onKeyboard(unsigned char key, void *param)
@@ -513,41 +739,57 @@ void TestGrid::step(float dtime)
 #define GR_AXTHICK LMIN	* 0.0004 // grid axis thickness
 #define GR_AXLEN LMIN	*  0.006  // grid axis length
 #define GRIDMIN (-GRIDLEN*GRIDSIZE/2.0+GRIDLEN)
+
+/**
+ * \brief Uploads the axis cross and the offsets of all grid points to GPU memory
+ *
+ * Must be called while the OpenGL context is current and the testgrid shader is loaded.
+ */
+void TestGrid::buildMesh()
+{
+	MeshBuilder builder;
+	builder.addBox(SimpleVec3d(-GR_AXLEN, -GR_AXTHICK, -GR_AXTHICK),
+		SimpleVec3d( GR_AXLEN,  GR_AXTHICK,  GR_AXTHICK));	// x-Axis
+	builder.addBox(SimpleVec3d(-GR_AXTHICK, -GR_AXLEN, -GR_AXTHICK),
+		SimpleVec3d( GR_AXTHICK,  GR_AXLEN,  GR_AXTHICK));	// y-Axis
+	builder.addBox(SimpleVec3d(-GR_AXTHICK, -GR_AXTHICK, -GR_AXLEN),
+		SimpleVec3d( GR_AXTHICK,  GR_AXTHICK,  GR_AXLEN));	// z-Axis
+	m_mesh = new MeshBuffer(MESH_NORMALS);
+	builder.upload(m_mesh);
+
+	// Per grid point: offset from the grid point next to the player
+	Shader *shader = game->getCamera()->getShaderManager()->getShader("testgrid");
+	m_instances = new InstanceBuffer();
+	m_instances->addAttribute(shader->getAttribLocation("grid_offset"), 3);
+
+	std::vector<GLfloat> offsets;
+	for (int x = 0; x < GRIDSIZE; x++)
+		for (int y = 0; y < GRIDSIZE; y++)
+			for (int z = 0; z < GRIDSIZE; z++)
+			{
+				GLfloat offset[3] = {
+					(GLfloat)(GRIDMIN + x * GRIDLEN),
+					(GLfloat)(GRIDMIN + y * GRIDLEN),
+					(GLfloat)(GRIDMIN + z * GRIDLEN)
+				};
+				offsets.insert(offsets.end(), offset, offset + 3);
+			}
+
+	m_instances->upload(&offsets[0], GRIDSIZE * GRIDSIZE * GRIDSIZE);
+}
+
+/**
+ * \brief Draws all grid points with a single instanced draw call
+ *
+ * The grid is positioned at the grid point next to the player (see step()), so the offsets
+ * never change and only the translation of the object changes when crossing grid cells.
+ */
 void TestGrid::render ()
 {
 	if (!m_draw) return;
-	SimpleVec3d(GRIDMIN, GRIDMIN, GRIDMIN).translate();
+	if (m_mesh == NULL) buildMesh();
 
-	SimpleColor(1, 1, 1, 1).setEmission();
-	double x, y, z;
-	for (x = 0; x<GRIDLEN*GRIDSIZE; x+=GRIDLEN)
-	{
-		for (y = 0; y<GRIDLEN*GRIDSIZE; y+=GRIDLEN)
-		{
-			for (z = 0; z<GRIDLEN*GRIDSIZE; z+=GRIDLEN)
-			{
-				glPushMatrix();
-				{
-					SimpleVec3d(x, y, z).translate();
-					// x-Axis
-					SimpleVec3d p3(-GR_AXLEN, -GR_AXTHICK, -GR_AXTHICK);
-					SimpleVec3d p4( GR_AXLEN,  GR_AXTHICK,  GR_AXTHICK);
-					makeCuboid(p3, p4, 1, 1, 1);
-
-					// y-Axis
-					SimpleVec3d p5(-GR_AXTHICK, -GR_AXLEN, -GR_AXTHICK);
-					SimpleVec3d p6( GR_AXTHICK,  GR_AXLEN,  GR_AXTHICK);
-					makeCuboid(p5, p6, 1, 1, 1);
-
-					// z-Axis
-					SimpleVec3d p1(-GR_AXTHICK, -GR_AXTHICK, -GR_AXLEN);
-					SimpleVec3d p2( GR_AXTHICK,  GR_AXTHICK,  GR_AXLEN);
-					makeCuboid(p1, p2, 1, 1, 1);
-				}
-				glPopMatrix();
-			}
-		}
-	}
+	m_mesh->renderInstanced(GL_TRIANGLES, m_instances);
 }
 
 
@@ -4,10 +4,15 @@
 #include "util.hpp"
 #include "objects.hpp"
 #include "teleport.hpp"
+#include "impostor.hpp"
+#include "shader.hpp"
 
 class WorldEnvironment;
 class Player;
 class SphereFraction;
+class InstanceBuffer;
+class CubeSphere;
+class MeshBuffer;
 
 // Returns position of the earth
 SimpleVec3d initUniverse(WorldEnvironment *w_env);
@@ -28,16 +33,29 @@ class Star : public PhysicalObject, public TeleportTarget, public MassObject
 		SimpleVec3d	getTeleportPos   ();
 		SimpleAngles	getTeleportAngles();
 
+		double getBoundingRadius();
+		double getOccluderRadius();
+
 	private:
+		/*
+			updateDetailThread refines the sphere progressively in the background,
+			based on the camera position (like Planet::updateDetailThread)
+		*/
+		void updateDetailThread();
+		bool m_upd_det_running;
+		std::thread m_upd_det_thread;
+
 		float m_radius;
 		SphereFraction *m_sphere;
 		SimpleColor m_color;
 		std::string m_name;
-		bool m_farmode; // drawing mode for being far away
+		ShaderHandle m_surface_shader;
 
 		// Corona:
 		GLfloat m_corona_vertices[4][2];
 		GLubyte m_corona_indices[4];
+		ShaderHandle m_corona_shader;
+		int16_t m_corona_radius_slot;
 };
 
 /// A single asteroid in a PlanetRing
@@ -56,16 +74,36 @@ class PlanetRing
 			float rotspeed_max, float minsize, float maxsize, float vertical_spread);
 		~PlanetRing();
 
-		void step(float dtime);
 		void render();
 
+		/// Distance of the outermost asteroid surface from the center of the Planet
+		float getOuterRadius()
+			{ return m_outer_radius; }
+
 	private:
+		void buildMesh();
+		void uploadOrbits(double epoch);
+
 		float m_radius;
 		float m_width;
 		float m_density;
+		float m_outer_radius;
 
+		/*
+			Positions at universe time 0, the position at any time t is a pure function
+			of t: the inclination is position.inclination + rotspeed * t
+		*/
 		std::vector<RingAsteroid> m_asteroids;
-		GLuint m_dodecahedron_displist;
+
+		// Universe time the uploaded inclinations refer to, the shader adds the rest
+		double m_epoch;
+
+		// Dodecahedron drawn once per asteroid, built by the first render() call
+		MeshBuffer *m_mesh;
+		InstanceBuffer *m_instances;
+
+		ShaderHandle m_shader;
+		int16_t m_time_slot;
 };
 
 /// A non-glowing, moving celestial body that has support for procedural generation
@@ -87,6 +125,9 @@ class Planet : public PhysicalObject, public TeleportTarget, public MassObject
 		SimpleVec3d	getTeleportPos   ();
 		SimpleAngles	getTeleportAngles();
 
+		double getBoundingRadius();
+		double getOccluderRadius();
+
 		SimpleVec3d getPos()
 			{ return m_pos; }
 		SimpleVec3d getVel()
@@ -104,13 +145,22 @@ class Planet : public PhysicalObject, public TeleportTarget, public MassObject
 		std::thread m_upd_det_thread;
 
 		float m_radius;
-		SphereFraction *m_pgensphere;
+		SphereFraction *m_pgensphere;	// NULL if m_cubesphere is used
+		CubeSphere *m_cubesphere;	// NULL if m_pgensphere is used
 
 		SimpleVec3d m_rotaxis;
 		float m_rotspeed;
 		float m_time;
 
 		std::string m_name;
+		ShaderHandle m_surface_shader;
+		int16_t m_preview_slot;
+		int16_t m_morph_start_slot;
+		int16_t m_morph_end_slot;
+		void requestSurfaceShader(int preview);
+
+		void renderImpostor(SimpleVec3d relpos, double distance);
+		Impostor m_impostor;
 
 		PlanetRing *m_ring;
 };
@@ -130,7 +180,12 @@ class TestGrid : public WorldObject
 
 	private:
 		float getNextGridPos(float num, float gridsize);
+		void buildMesh();
 		bool m_draw;
+
+		// Axis cross drawn once per grid point, built by the first render() call
+		MeshBuffer *m_mesh;
+		InstanceBuffer *m_instances;
 };
 
 #endif
@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <math.h>
+
+#include "gllibs.hpp"
+
+#include "mesh.hpp"
+
+#define BUFFER_OFFSET(bytes) ((const GLvoid *)(uintptr_t)(bytes))
+
+/**
+ * \brief Creates an empty MeshBuffer
+ * \param layout Combination of mesh_layout flags that describes the vertex format
+ *
+ * The buffer objects are only created on the first call to upload(), so that
+ * MeshBuffers can also be constructed while no OpenGL context is current.
+ */
+MeshBuffer::MeshBuffer(uint8_t layout) :
+m_vbo(0),
+m_ibo(0),
+m_layout(layout),
+m_indextype(GL_UNSIGNED_INT),
+m_indexnum(0),
+m_vertexnum(0)
+{
+	GLsizei floats = 3;
+	if (m_layout & MESH_NORMALS) floats += 3;
+	if (m_layout & MESH_MORPH)   floats += 3;
+	m_stride = floats * sizeof(GLfloat);
+}
+
+/// Deletes the buffer objects, must be called while the OpenGL context is current
+MeshBuffer::~MeshBuffer()
+{
+	if (m_vbo != 0) glDeleteBuffers(1, &m_vbo);
+	if (m_ibo != 0) glDeleteBuffers(1, &m_ibo);
+}
+
+/**
+ * \brief Transfers vertices and indices to GPU memory
+ * \param vertices Interleaved vertex data as described by the layout
+ * \param vertexnum Number of vertices
+ * \param indices Index data, of type indextype
+ * \param indexnum Number of indices
+ * \param indextype GL_UNSIGNED_INT, GL_UNSIGNED_SHORT or GL_UNSIGNED_BYTE
+ * \param usage Usage hint for OpenGL, GL_STATIC_DRAW by default
+ *
+ * The passed arrays are not referenced afterwards and can be freed.
+ */
+void MeshBuffer::upload(const GLfloat *vertices, uint32_t vertexnum, const GLvoid *indices,
+		uint32_t indexnum, GLenum indextype, GLenum usage)
+{
+	uploadVertices(vertices, vertexnum, usage);
+	uploadIndices(indices, indexnum, indextype, usage);
+}
+
+/**
+ * \brief Transfers only vertices to GPU memory, e.g. to draw them with shared indices
+ * \param vertices Interleaved vertex data as described by the layout
+ * \param vertexnum Number of vertices
+ * \param usage Usage hint for OpenGL, GL_STATIC_DRAW by default
+ */
+void MeshBuffer::uploadVertices(const GLfloat *vertices, uint32_t vertexnum, GLenum usage)
+{
+	if (m_vbo == 0) glGenBuffers(1, &m_vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexnum * m_stride, vertices, usage);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_vertexnum = vertexnum;
+}
+
+/**
+ * \brief Transfers only indices to GPU memory, e.g. to share them between several meshes
+ * \param indices Index data, of type indextype
+ * \param indexnum Number of indices
+ * \param indextype GL_UNSIGNED_INT, GL_UNSIGNED_SHORT or GL_UNSIGNED_BYTE
+ * \param usage Usage hint for OpenGL, GL_STATIC_DRAW by default
+ */
+void MeshBuffer::uploadIndices(const GLvoid *indices, uint32_t indexnum, GLenum indextype,
+		GLenum usage)
+{
+	if (m_ibo == 0) glGenBuffers(1, &m_ibo);
+
+	size_t indexsize = sizeof(GLuint);
+	if (indextype == GL_UNSIGNED_SHORT)	indexsize = sizeof(GLushort);
+	else if (indextype == GL_UNSIGNED_BYTE)	indexsize = sizeof(GLubyte);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexnum * indexsize, indices, usage);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	m_indextype = indextype;
+	m_indexnum = indexnum;
+}
+
+/**
+ * \brief Draws all uploaded indices
+ * \param mode The primitive type, e.g. GL_QUADS or GL_TRIANGLES
+ */
+void MeshBuffer::render(GLenum mode)
+{
+	renderRange(mode, 0, m_indexnum);
+}
+
+/**
+ * \brief Draws a part of the uploaded indices
+ * \param mode The primitive type, e.g. GL_QUADS or GL_TRIANGLES
+ * \param first The first index to draw
+ * \param count The number of indices to draw
+ * \param indexbuffer Draw with the indices of this MeshBuffer instead of the own ones
+ */
+void MeshBuffer::renderRange(GLenum mode, uint32_t first, uint32_t count, MeshBuffer *indexbuffer)
+{
+	if (indexbuffer == NULL) indexbuffer = this;
+	if (m_vbo == 0 || indexbuffer->m_ibo == 0 || count == 0) return;
+
+	GLenum indextype = indexbuffer->m_indextype;
+	size_t indexsize = sizeof(GLuint);
+	if (indextype == GL_UNSIGNED_SHORT)		indexsize = sizeof(GLushort);
+	else if (indextype == GL_UNSIGNED_BYTE)	indexsize = sizeof(GLubyte);
+
+	bind(indexbuffer);
+	glDrawElements(mode, count, indextype, BUFFER_OFFSET(first * indexsize));
+	unbind();
+}
+
+/**
+ * \brief Draws all uploaded indices once for every instance
+ * \param mode The primitive type, e.g. GL_TRIANGLES
+ * \param instances The per-instance attributes
+ *
+ * Uses a single instanced draw call if the driver supports it (see InstanceBuffer).
+ */
+void MeshBuffer::renderInstanced(GLenum mode, InstanceBuffer *instances)
+{
+	if (m_vbo == 0 || m_ibo == 0 || m_indexnum == 0 || instances->m_instancenum == 0) return;
+
+	bind(this);
+
+	if (InstanceBuffer::isSupported())
+	{
+		instances->bind();
+		glDrawElementsInstancedARB(mode, m_indexnum, m_indextype, BUFFER_OFFSET(0),
+			instances->m_instancenum);
+		instances->unbind();
+	}
+	else
+	{
+		for (uint32_t i = 0; i < instances->m_instancenum; i++)
+		{
+			instances->setAttributes(i);
+			glDrawElements(mode, m_indexnum, m_indextype, BUFFER_OFFSET(0));
+		}
+	}
+
+	unbind();
+}
+
+/**
+ * \brief Binds the buffer objects and sets up the client state for the vertex layout
+ * \param indexbuffer The MeshBuffer whose index buffer object is to be bound
+ */
+void MeshBuffer::bind(MeshBuffer *indexbuffer)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexbuffer->m_ibo);
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_NORMAL_ARRAY);
+
+	glVertexPointer(3, GL_FLOAT, m_stride, BUFFER_OFFSET(0));
+
+	size_t offset = 3 * sizeof(GLfloat);
+	if (m_layout & MESH_NORMALS)
+	{
+		glNormalPointer(GL_FLOAT, m_stride, BUFFER_OFFSET(offset));
+		offset += 3 * sizeof(GLfloat);
+	}
+	else
+	{
+		glNormalPointer(GL_FLOAT, m_stride, BUFFER_OFFSET(0));
+	}
+
+	if (m_layout & MESH_MORPH)
+	{
+		glClientActiveTexture(GL_TEXTURE1);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(3, GL_FLOAT, m_stride, BUFFER_OFFSET(offset));
+		glClientActiveTexture(GL_TEXTURE0);
+	}
+}
+
+/// Restores the client state and unbinds the buffer objects
+void MeshBuffer::unbind()
+{
+	if (m_layout & MESH_MORPH)
+	{
+		glClientActiveTexture(GL_TEXTURE1);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTexture(GL_TEXTURE0);
+	}
+
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/*
+	InstanceBuffer
+*/
+
+/// Creates an empty InstanceBuffer, the buffer object is created on the first upload()
+InstanceBuffer::InstanceBuffer() :
+m_vbo(0),
+m_instancenum(0),
+m_stride(0)
+{
+}
+
+/// Deletes the buffer object, must be called while the OpenGL context is current
+InstanceBuffer::~InstanceBuffer()
+{
+	if (m_vbo != 0) glDeleteBuffers(1, &m_vbo);
+}
+
+/**
+ * \brief Returns true if the driver can draw all instances with a single call
+ */
+bool InstanceBuffer::isSupported()
+{
+	return GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+}
+
+/**
+ * \brief Appends an attribute to the layout of an instance
+ * \param location The location of the attribute in the shader, see Shader::getAttribLocation
+ * \param components Number of floats of the attribute, 1 to 4
+ *
+ * Attributes with location -1 (optimized out by the shader compiler) are skipped when drawing.
+ */
+void InstanceBuffer::addAttribute(GLint location, GLint components)
+{
+	m_attributes.push_back(std::make_pair(location, components));
+	m_stride += components * sizeof(GLfloat);
+}
+
+/**
+ * \brief Transfers the instance attributes to GPU memory
+ * \param instances Interleaved attributes of all instances, as described by addAttribute()
+ * \param instancenum Number of instances
+ * \param usage Usage hint for OpenGL, GL_STATIC_DRAW by default
+ */
+void InstanceBuffer::upload(const GLfloat *instances, uint32_t instancenum, GLenum usage)
+{
+	m_instancenum = instancenum;
+
+	if (!isSupported())
+	{
+		m_instances.assign(instances, instances + instancenum * m_stride / sizeof(GLfloat));
+		return;
+	}
+
+	if (m_vbo == 0) glGenBuffers(1, &m_vbo);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, instancenum * m_stride, instances, usage);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// Sets up the attribute arrays, which advance once per instance
+void InstanceBuffer::bind()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+	size_t offset = 0;
+	for (auto &attribute : m_attributes)
+	{
+		if (attribute.first != -1)
+		{
+			glEnableVertexAttribArray(attribute.first);
+			glVertexAttribPointer(attribute.first, attribute.second, GL_FLOAT, GL_FALSE,
+				m_stride, BUFFER_OFFSET(offset));
+			glVertexAttribDivisorARB(attribute.first, 1);
+		}
+		offset += attribute.second * sizeof(GLfloat);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/// Disables the attribute arrays again
+void InstanceBuffer::unbind()
+{
+	for (auto &attribute : m_attributes)
+	{
+		if (attribute.first == -1) continue;
+		glVertexAttribDivisorARB(attribute.first, 0);
+		glDisableVertexAttribArray(attribute.first);
+	}
+}
+
+/**
+ * \brief Sets the attributes of a single instance as constant vertex attributes (fallback)
+ * \param instance The index of the instance
+ */
+void InstanceBuffer::setAttributes(uint32_t instance)
+{
+	const GLfloat *data = &m_instances[instance * m_stride / sizeof(GLfloat)];
+
+	for (auto &attribute : m_attributes)
+	{
+		GLfloat value[4] = { 0, 0, 0, 1 };
+		std::copy(data, data + attribute.second, value);
+		if (attribute.first != -1) glVertexAttrib4fv(attribute.first, value);
+		data += attribute.second;
+	}
+}
+
+/*
+	MeshBuilder
+*/
+
+/**
+ * \brief Returns any unit vector that is perpendicular to the given one
+ */
+static SimpleVec3d getPerpendicularUnit(SimpleVec3d vec)
+{
+	// Cross product with the axis that is the least parallel to vec
+	SimpleVec3d axis(1, 0, 0);
+	if (fabs(vec.y) < fabs(vec.x) && fabs(vec.y) <= fabs(vec.z)) axis = SimpleVec3d(0, 1, 0);
+	else if (fabs(vec.z) < fabs(vec.x)) axis = SimpleVec3d(0, 0, 1);
+
+	return crossProduct(vec, axis).normalize();
+}
+
+/**
+ * \brief Adds an axis-aligned box
+ * \param c1 One corner of the box
+ * \param c2 The opposite corner of the box
+ */
+void MeshBuilder::addBox(SimpleVec3d c1, SimpleVec3d c2)
+{
+	double lo[3] = { std::min(c1.x, c2.x), std::min(c1.y, c2.y), std::min(c1.z, c2.z) };
+	double hi[3] = { std::max(c1.x, c2.x), std::max(c1.y, c2.y), std::max(c1.z, c2.z) };
+
+	for (int axis = 0; axis < 3; axis++)
+	for (int side = 0; side < 2; side++)
+	{
+		// u x v = axis, so the corners are counter-clockwise when looking at the positive side
+		int u = (axis + 1) % 3, v = (axis + 2) % 3;
+		double normal[3] = { 0, 0, 0 };
+		normal[axis] = side ? 1 : -1;
+
+		GLuint corners[4];
+		for (int c = 0; c < 4; c++)
+		{
+			double pos[3];
+			pos[axis] = side ? hi[axis] : lo[axis];
+			pos[u] = (c == 1 || c == 2) ? hi[u] : lo[u];
+			pos[v] = (c >= 2) ? hi[v] : lo[v];
+
+			corners[c] = addVertex(SimpleVec3d(pos[0], pos[1], pos[2]),
+				SimpleVec3d(normal[0], normal[1], normal[2]));
+		}
+
+		if (side)
+		{
+			addTriangle(corners[0], corners[1], corners[2]);
+			addTriangle(corners[0], corners[2], corners[3]);
+		}
+		else
+		{
+			addTriangle(corners[0], corners[2], corners[1]);
+			addTriangle(corners[0], corners[3], corners[2]);
+		}
+	}
+}
+
+/**
+ * \brief Adds a UV sphere
+ * \param center The center of the sphere
+ * \param radius The radius of the sphere
+ * \param slices Number of subdivisions around the z axis
+ * \param stacks Number of subdivisions along the z axis
+ */
+void MeshBuilder::addSphere(SimpleVec3d center, float radius, uint16_t slices, uint16_t stacks)
+{
+	GLuint first = getVertexNum();
+
+	for (uint16_t i = 0; i <= stacks; i++)
+	for (uint16_t j = 0; j <= slices; j++)
+	{
+		double inclination = PI * i / stacks;
+		double azimuth = 2 * PI * j / slices;
+		SimpleVec3d normal(sin(inclination) * cos(azimuth), sin(inclination) * sin(azimuth),
+			cos(inclination));
+		addVertex(center + normal * radius, normal);
+	}
+
+	for (uint16_t i = 0; i < stacks; i++)
+	for (uint16_t j = 0; j < slices; j++)
+	{
+		GLuint a = first + i * (slices + 1) + j;
+		GLuint b = a + slices + 1;
+
+		// The triangles touching the poles would be degenerate
+		if (i != stacks - 1)	addTriangle(a, b, b + 1);
+		if (i != 0)		addTriangle(a, b + 1, a + 1);
+	}
+}
+
+/**
+ * \brief Adds a cylinder
+ * \param base The center of the bottom of the cylinder
+ * \param axis The vector from the center of the bottom to the center of the top
+ * \param radius The radius of the cylinder
+ * \param slices Number of subdivisions around the axis
+ * \param caps True to close the cylinder with disks at both ends
+ */
+void MeshBuilder::addCylinder(SimpleVec3d base, SimpleVec3d axis, float radius, uint16_t slices,
+		bool caps)
+{
+	SimpleVec3d w = SimpleVec3d(axis).normalize();
+	SimpleVec3d u = getPerpendicularUnit(w);
+	SimpleVec3d v = crossProduct(w, u);
+
+	GLuint first = getVertexNum();
+	for (uint16_t j = 0; j <= slices; j++)
+	{
+		double angle = 2 * PI * j / slices;
+		SimpleVec3d normal = u * cos(angle) + v * sin(angle);
+		addVertex(base + normal * radius, normal);
+		addVertex(base + axis + normal * radius, normal);
+	}
+
+	for (uint16_t j = 0; j < slices; j++)
+	{
+		GLuint a = first + 2 * j;
+		addTriangle(a, a + 2, a + 3);
+		addTriangle(a, a + 3, a + 1);
+	}
+
+	if (!caps) return;
+
+	// Disks with their own vertices, as the normals differ from the side
+	for (int side = 0; side < 2; side++)
+	{
+		SimpleVec3d normal = side ? w : w * -1;
+		SimpleVec3d center = side ? base + axis : base;
+
+		GLuint center_id = addVertex(center, normal);
+		for (uint16_t j = 0; j <= slices; j++)
+		{
+			double angle = 2 * PI * j / slices;
+			addVertex(center + (u * cos(angle) + v * sin(angle)) * radius, normal);
+		}
+
+		for (uint16_t j = 0; j < slices; j++)
+		{
+			if (side)	addTriangle(center_id, center_id + 1 + j, center_id + 2 + j);
+			else		addTriangle(center_id, center_id + 2 + j, center_id + 1 + j);
+		}
+	}
+}
+
+/**
+ * \brief Adds a regular dodecahedron with flat faces, like glutSolidDodecahedron
+ * \param center The center of the dodecahedron
+ * \param scale Scaling factor, the corners have a distance of sqrt(3) * scale to the center
+ */
+void MeshBuilder::addDodecahedron(SimpleVec3d center, float scale)
+{
+	const double phi = (1 + sqrt(5.0)) / 2;
+
+	// Corners: (+-1, +-1, +-1) and cyclic permutations of (0, +-1/phi, +-phi)
+	std::vector<SimpleVec3d> corners;
+	for (int n = 0; n < 8; n++)
+		corners.push_back(SimpleVec3d(n & 1 ? 1 : -1, n & 2 ? 1 : -1, n & 4 ? 1 : -1));
+	for (int n = 0; n < 4; n++)
+	{
+		double a = (n & 1 ? 1 : -1) / phi, b = (n & 2 ? 1 : -1) * phi;
+		corners.push_back(SimpleVec3d(0, a, b));
+		corners.push_back(SimpleVec3d(a, b, 0));
+		corners.push_back(SimpleVec3d(b, 0, a));
+	}
+
+	// Face normals point to the corners of an icosahedron: cyclic permutations of (0, +-phi, +-1)
+	for (int n = 0; n < 12; n++)
+	{
+		double a = (n & 1) ? phi : -phi, b = (n & 2) ? 1 : -1;
+		SimpleVec3d normal = (n / 4 == 0) ? SimpleVec3d(0, a, b) :
+			(n / 4 == 1) ? SimpleVec3d(a, b, 0) : SimpleVec3d(b, 0, a);
+		normal = normal.normalize();
+
+		// The five corners closest to the normal, sorted counter-clockwise around it
+		std::vector<SimpleVec3d> face(corners);
+		std::sort(face.begin(), face.end(), [&normal](SimpleVec3d p, SimpleVec3d q)
+			{ return dotProduct(p, normal) > dotProduct(q, normal); });
+		face.resize(5);
+
+		SimpleVec3d u = getPerpendicularUnit(normal);
+		SimpleVec3d v = crossProduct(normal, u);
+		std::sort(face.begin(), face.end(), [&u, &v](SimpleVec3d p, SimpleVec3d q)
+			{ return atan2(dotProduct(p, v), dotProduct(p, u))
+				< atan2(dotProduct(q, v), dotProduct(q, u)); });
+
+		GLuint first = getVertexNum();
+		for (auto &corner : face)
+			addVertex(center + corner * scale, normal);
+
+		for (GLuint c = 1; c < 4; c++)
+			addTriangle(first, first + c, first + c + 1);
+	}
+}
+
+/**
+ * \brief Uploads all added geometry to a MeshBuffer with the MESH_NORMALS layout
+ * \param buffer The MeshBuffer to upload to
+ *
+ * Uses 16-bit indices if the number of vertices allows it.
+ */
+void MeshBuilder::upload(MeshBuffer *buffer)
+{
+	if (getVertexNum() <= 65536)
+	{
+		std::vector<GLushort> indices(m_indices.begin(), m_indices.end());
+		buffer->upload(&m_vertices[0], getVertexNum(), &indices[0], indices.size(),
+			GL_UNSIGNED_SHORT);
+	}
+	else
+	{
+		buffer->upload(&m_vertices[0], getVertexNum(), &m_indices[0], m_indices.size(),
+			GL_UNSIGNED_INT);
+	}
+}
+
+/**
+ * \brief Appends a vertex and returns its index
+ */
+GLuint MeshBuilder::addVertex(SimpleVec3d pos, SimpleVec3d normal)
+{
+	GLfloat vertex[6] = {
+		(GLfloat)pos.x, (GLfloat)pos.y, (GLfloat)pos.z,
+		(GLfloat)normal.x, (GLfloat)normal.y, (GLfloat)normal.z
+	};
+	m_vertices.insert(m_vertices.end(), vertex, vertex + 6);
+
+	return getVertexNum() - 1;
+}
+
+/**
+ * \brief Appends a triangle, the vertices must be in counter-clockwise order
+ */
+void MeshBuilder::addTriangle(GLuint a, GLuint b, GLuint c)
+{
+	m_indices.push_back(a);
+	m_indices.push_back(b);
+	m_indices.push_back(c);
+}
@@ -0,0 +1,144 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "gllibs.hpp"
+#include "util.hpp"
+
+/**
+ * \brief Vertex layouts of a MeshBuffer
+ *
+ * Every vertex starts with three floats for the position. The flags add further
+ * attributes that follow the position in the given order.
+ */
+enum mesh_layout
+{
+	MESH_POSITION = 0,	/** Position only, it is also used as normal (spheres) */
+	MESH_NORMALS = 1 << 0,	/** Three floats normal */
+	MESH_MORPH = 1 << 1	/** Three floats morph target, texture coordinates of unit 1 */
+};
+
+class InstanceBuffer;
+
+/// Vertex and index data in OpenGL buffer objects, uploaded once and drawn from GPU memory
+class MeshBuffer
+{
+	public:
+		MeshBuffer(uint8_t layout = MESH_POSITION);
+		~MeshBuffer();
+
+		void upload(const GLfloat *vertices, uint32_t vertexnum, const GLvoid *indices,
+			uint32_t indexnum, GLenum indextype, GLenum usage = GL_STATIC_DRAW);
+		void uploadVertices(const GLfloat *vertices, uint32_t vertexnum,
+			GLenum usage = GL_STATIC_DRAW);
+		void uploadIndices(const GLvoid *indices, uint32_t indexnum, GLenum indextype,
+			GLenum usage = GL_STATIC_DRAW);
+
+		void render(GLenum mode);
+		void renderRange(GLenum mode, uint32_t first, uint32_t count,
+			MeshBuffer *indexbuffer = NULL);
+		void renderInstanced(GLenum mode, InstanceBuffer *instances);
+
+		/// Number of indices uploaded by the last call to upload()
+		uint32_t getIndexNum()
+			{ return m_indexnum; }
+
+		/// Number of vertices uploaded by the last call to upload()
+		uint32_t getVertexNum()
+			{ return m_vertexnum; }
+
+	private:
+		void bind(MeshBuffer *indexbuffer);
+		void unbind();
+
+		GLuint m_vbo;
+		GLuint m_ibo;
+
+		uint8_t m_layout;
+		GLsizei m_stride;
+		GLenum m_indextype;
+		uint32_t m_indexnum;
+		uint32_t m_vertexnum;
+};
+
+/**
+ * \brief Per-instance vertex attributes for MeshBuffer::renderInstanced
+ *
+ * Every instance consists of a fixed number of floats, which are split into generic vertex
+ * attributes of the shader in the order they were added by addAttribute(). If the driver
+ * does not support instanced arrays, the instances are drawn one after another with the
+ * attributes set from a copy in main memory instead.
+ */
+class InstanceBuffer
+{
+	public:
+		InstanceBuffer();
+		~InstanceBuffer();
+
+		void addAttribute(GLint location, GLint components);
+		void upload(const GLfloat *instances, uint32_t instancenum,
+			GLenum usage = GL_STATIC_DRAW);
+
+		/// Number of instances uploaded by the last call to upload()
+		uint32_t getInstanceNum()
+			{ return m_instancenum; }
+
+		static bool isSupported();
+
+	private:
+		friend class MeshBuffer;
+
+		void bind();
+		void unbind();
+		void setAttributes(uint32_t instance);
+
+		GLuint m_vbo;
+		uint32_t m_instancenum;
+
+		// Attribute locations and their number of floats, -1 = not used by the shader
+		std::vector<std::pair<GLint, GLint>> m_attributes;
+		GLsizei m_stride;
+
+		// Copy of the instances for drivers without instanced arrays
+		std::vector<GLfloat> m_instances;
+};
+
+/**
+ * \brief Assembles static geometry with positions and normals (MESH_NORMALS) on the CPU
+ *
+ * All shapes are appended to the same vertex and index arrays as counter-clockwise triangles,
+ * so that several parts can be drawn from one MeshBuffer. getIndexNum() before and after
+ * adding a part gives its index range for MeshBuffer::renderRange.
+ */
+class MeshBuilder
+{
+	public:
+		MeshBuilder() {};
+
+		void addBox(SimpleVec3d c1, SimpleVec3d c2);
+		void addSphere(SimpleVec3d center, float radius, uint16_t slices, uint16_t stacks);
+		void addCylinder(SimpleVec3d base, SimpleVec3d axis, float radius, uint16_t slices,
+			bool caps);
+		void addDodecahedron(SimpleVec3d center, float scale);
+
+		void upload(MeshBuffer *buffer);
+
+		/// Number of indices added so far
+		uint32_t getIndexNum()
+			{ return m_indices.size(); }
+
+		/// Number of vertices added so far
+		uint32_t getVertexNum()
+			{ return m_vertices.size() / 6; }
+
+	private:
+		GLuint addVertex(SimpleVec3d pos, SimpleVec3d normal);
+		void addTriangle(GLuint a, GLuint b, GLuint c);
+
+		std::vector<GLfloat> m_vertices;
+		std::vector<GLuint> m_indices;
+};
+
+#endif
@@ -2,8 +2,24 @@
 #define OBJECTS_H
 
 #include <iostream>
+#include <string>
 #include "util.hpp"
 #include "light.hpp"
+#include "ecs.hpp"
+
+/**
+ * \brief Material groups of WorldObjects, used for sorting by the RenderQueue
+ *
+ * Objects with MATERIAL_DEFAULT leave the OpenGL material untouched. All objects of
+ * any other group set every material parameter they rely on themselves, so the material
+ * only has to be reset when the group changes.
+ */
+enum render_material
+{
+	MATERIAL_DEFAULT = 0,	/** Does not change the material */
+	MATERIAL_EMISSIVE = 1,	/** Sets its own color and emission */
+	MATERIAL_SPACESHIP = 2	/** SpaceShip colors, route and navigation path */
+};
 
 /*
 	Object classes
@@ -54,7 +70,13 @@ class GenericObject
 class WorldObject : public GenericObject
 {
 	public:
-		WorldObject() : GenericObject() {};
+		WorldObject() :
+			GenericObject(),
+			m_shader("default"),
+			m_shader_id(-1),
+			m_material(MATERIAL_DEFAULT),
+			m_translucent(false)
+			{};
 		virtual ~WorldObject() {};
 
 		/**
@@ -68,12 +90,48 @@ class WorldObject : public GenericObject
 		SimpleVec3d getPos()
 			{ return m_pos; };
 
-		LightSpec getLightSpec ()
+		LightSpec &getLightSpec ()
 			{ return m_light; };
 
+		/// Radius of a sphere around getPos() that contains the object, negative if unknown
+		virtual double getBoundingRadius()
+			{ return -1; };
+
+		/// Radius of a solid sphere around getPos() that hides what is behind it, 0 if none
+		virtual double getOccluderRadius()
+			{ return 0; };
+
+		/**
+		 * \brief Name of the shader that has to be active when render() is called
+		 *
+		 * The Camera activates this shader before render() and groups objects with the
+		 * same shader. render() only has to request it again to transfer parameters.
+		 */
+		const std::string &getShaderName()
+			{ return m_shader; };
+
+		/// Cached ShaderManager ID of getShaderName(), -1 if not resolved yet
+		int16_t getShaderID()
+			{ return m_shader_id; };
+		void setShaderID(int16_t id)
+			{ m_shader_id = id; };
+
+		/// The render_material group of the object
+		uint16_t getMaterial()
+			{ return m_material; };
+
+		/// True if the object uses blending and must be drawn back-to-front
+		bool getTranslucent()
+			{ return m_translucent; };
+
 	protected:
 		SimpleVec3d m_pos;
 		LightSpec m_light;
+
+		std::string m_shader;
+		int16_t m_shader_id;
+		uint16_t m_material;
+		bool m_translucent;
 };
 
 // Physical Object
@@ -100,14 +158,23 @@ class PhysicalObject : public WorldObject
 class MassObject
 {
 	public:
-		MassObject() : m_mass(0) {};
+		MassObject() : m_mass(0), m_mass_entity(ECS_NO_ENTITY) {};
 
 		/// Get the mass of the object.
 		double getMass()
 			{ return m_mass; };
 
+		/// Entity with the MassComponent of the object, assigned by the WorldEnvironment
+		Entity getMassEntity()
+			{ return m_mass_entity; };
+		void setMassEntity(Entity entity)
+			{ m_mass_entity = entity; };
+
 	protected:
 		double m_mass; // in kg
+
+	private:
+		Entity m_mass_entity;
 };
 
 // Static Object
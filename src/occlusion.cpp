@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <math.h>
+
+#include "occlusion.hpp"
+
+/**
+ * \brief Removes all occluders, to be called once per frame before adding them again
+ */
+void OcclusionCuller::clear()
+{
+	m_occluders.clear();
+	m_culled = 0;
+}
+
+/**
+ * \brief Adds a sphere that hides objects behind it
+ * \param relpos The position of the sphere's center relative to the player
+ * \param radius A radius the sphere is completely solid within
+ *
+ * Occluders that contain the player are ignored.
+ */
+void OcclusionCuller::addOccluder(SimpleVec3d relpos, double radius)
+{
+	double distance = getVectorLength(relpos);
+	if (radius <= 0 || distance <= radius) return;
+
+	m_occluders.push_back(OcclusionSphere { relpos / distance, distance, asin(radius / distance) });
+}
+
+/**
+ * \brief Returns true if a sphere is completely hidden behind any occluder
+ * \param relpos The position of the sphere's center relative to the player
+ * \param radius The bounding radius of the sphere, negative if unknown (never hidden)
+ *
+ * The sphere is hidden if the cone it covers lies within the cone of an occluder and its
+ * nearest point is farther away than the occluder's center, which is always behind the
+ * occluder's surface within its cone. So the test is conservative and also rejects
+ * objects that are the occluder themselves.
+ */
+bool OcclusionCuller::isOccluded(SimpleVec3d relpos, double radius)
+{
+	if (radius < 0) return false;
+
+	double distance = getVectorLength(relpos);
+	if (distance <= radius) return false;
+
+	SimpleVec3d dir = relpos / distance;
+	double angle = asin(radius / distance);
+
+	for (auto &occluder : m_occluders)
+	{
+		if (distance - radius < occluder.distance) continue;
+
+		double cosangle = std::max(-1.0, std::min(1.0, dotProduct(dir, occluder.dir)));
+		if (acos(cosangle) + angle <= occluder.angle)
+		{
+			m_culled++;
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,42 @@
+#ifndef _OCCLUSION_H
+#define _OCCLUSION_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "util.hpp"
+
+/// Sphere that hides what is behind it, as seen from the player
+struct OcclusionSphere
+{
+	SimpleVec3d dir;	// normalized direction from the player
+	double distance;	// distance of the center from the player
+	double angle;		// angular radius as seen from the player
+};
+
+/**
+ * \brief CPU-side occlusion culling with spheres (Stars and Planets) as occluders
+ *
+ * An object is hidden if its bounding sphere lies within the cone that an occluder covers
+ * as seen from the player and is entirely farther away than the occluder's center. No GPU
+ * queries are needed, there are only a few occluders.
+ */
+class OcclusionCuller
+{
+	public:
+		OcclusionCuller() : m_culled(0) {};
+
+		void clear();
+		void addOccluder(SimpleVec3d relpos, double radius);
+		bool isOccluded(SimpleVec3d relpos, double radius);
+
+		/// Number of objects isOccluded() returned true for since clear()
+		uint32_t getCulledNum()
+			{ return m_culled; }
+
+	private:
+		std::vector<OcclusionSphere> m_occluders;
+		uint32_t m_culled;
+};
+
+#endif
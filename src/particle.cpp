@@ -39,7 +39,7 @@ m_minspeed(minspeed),
 m_maxspeed(maxspeed),
 m_particle_mintime(particle_mintime),
 m_particle_maxtime(particle_maxtime),
-m_shader(shader),
+m_particle_shader(shader),
 m_num_shouldemit_particles(0)
 {
 	m_pos = pos;
@@ -56,10 +56,22 @@ void FireParticleSource::render()
 	// do nothing, not rendered
 }
 
-void FireParticleSource::step(float dtime)
+/**
+ * \brief Emits the particles, in the main thread as they are added to the EntityStore
+ * \param dtime The time in seconds that passed since this was called last
+ */
+void FireParticleSource::stepMainThread(float dtime)
 {
 	m_num_shouldemit_particles += m_intensity * dtime;
 
+	if (m_particle_shader.resolve())
+	{
+		m_particle_slots.id = m_particle_shader.getID();
+		m_particle_slots.size_slot = m_particle_shader->getUniformSlot("size");
+		m_particle_slots.time_slot = m_particle_shader->getUniformSlot("time");
+		m_particle_slots.exptime_slot = m_particle_shader->getUniformSlot("exptime");
+	}
+
 	while (m_num_emitted_particles < m_num_shouldemit_particles)
 	{
 		m_num_emitted_particles++; // number of fire particles emitted
@@ -78,7 +90,7 @@ void FireParticleSource::step(float dtime)
 			(1.0 * rand() / RAND_MAX) * (m_particle_maxtime  - m_particle_mintime);
 		exptime *= game->getGameSpeed();
 		game->getWorldEnv()->addObject(
-			new FireParticle(m_pos, thisvel + m_init_vel, m_shader, size, exptime));
+			new FireParticle(m_pos, thisvel + m_init_vel, m_particle_slots, size, exptime));
 	}
 }
 
@@ -90,14 +102,20 @@ void FireParticleSource::step(float dtime)
 /**
  * Prepares vertices and indices of the FireParticle
  */
-FireParticle::FireParticle(SimpleVec3d pos, SimpleVec3d vel, std::string shader, float size, float exptime) :
-m_shader(shader),
+FireParticle::FireParticle(SimpleVec3d pos, SimpleVec3d vel, FireParticleShader shader, float size, float exptime) :
+m_slots(shader),
 m_time(0),
 m_size(size),
 m_exptime(exptime)
 {
 	m_pos = pos;
-	m_velocity = vel;
+	m_shader_id = shader.id;
+	m_translucent = true;
+
+	EntityStore &entities = game->getWorldEnv()->getEntities();
+	m_entity = entities.create();
+	entities.getTransforms().add(m_entity, TransformComponent { pos });
+	entities.getKinematics().add(m_entity, KinematicsComponent { vel, SimpleVec3d(0, 0, 0) });
 
 	m_vertices[0][0] = -m_size;
 	m_vertices[0][1] = -m_size;
@@ -116,17 +134,19 @@ m_exptime(exptime)
 		m_indices[i] = i;
 }
 
-/// Empty
 FireParticle::~FireParticle()
 {
+	game->getWorldEnv()->getEntities().destroy(m_entity);
 }
 
 void FireParticle::render()
 {
-	game->getCamera()->getShaderManager()->getShader(m_shader)->addParameterf("size", m_size);
-	game->getCamera()->getShaderManager()->getShader(m_shader)->addParameterf("time", m_time);
-	game->getCamera()->getShaderManager()->getShader(m_shader)->addParameterf("exptime", m_exptime);
-	game->getCamera()->getShaderManager()->requestShader(m_shader);
+	ShaderManager *shaderman = game->getCamera()->getShaderManager();
+	Shader *shader = shaderman->getShader(m_slots.id);
+	shader->setUniformf(m_slots.size_slot, m_size);
+	shader->setUniformf(m_slots.time_slot, m_time);
+	shader->setUniformf(m_slots.exptime_slot, m_exptime);
+	shaderman->requestShader(m_slots.id);
 	glMultMatrixf(glm::value_ptr(m_rotmatrix));
 
 	glEnableClientState(GL_VERTEX_ARRAY);
@@ -146,10 +166,14 @@ void FireParticle::step(float dtime)
 		return;
 	}
 
-	physicalMove(dtime);
 	m_time += dtime;
 
 	// Make the particle face the player
 	glm::quat rotquat = game->getPlayer()->getLookQuat();
 	m_rotmatrix = glm::toMat4(rotquat);
 }
+
+void FireParticle::stepMainThread(float dtime)
+{
+	m_pos = game->getWorldEnv()->getEntities().getTransforms().get(m_entity).pos;
+}
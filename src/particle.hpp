@@ -1,10 +1,20 @@
 #include "gllibs.hpp"
 #include "objects.hpp"
+#include "shader.hpp"
 #include "util.hpp"
 
 #ifndef _PARTICLE_H
 #define _PARTICLE_H
 
+/// Shader of FireParticles and its uniform slots, looked up once by their FireParticleSource
+struct FireParticleShader
+{
+	int16_t id;
+	int16_t size_slot;
+	int16_t time_slot;
+	int16_t exptime_slot;
+};
+
 /// Emits FireParticle in a random fashion
 class FireParticleSource : public WorldObject
 {
@@ -17,7 +27,7 @@ class FireParticleSource : public WorldObject
 
 
 		void render();
-		void step(float dtime);
+		void stepMainThread(float dtime);
 
 		/// Remove the FireParticleSource
 		void remove()
@@ -50,28 +60,35 @@ class FireParticleSource : public WorldObject
 		float m_maxspeed;
 		float m_particle_mintime;
 		float m_particle_maxtime;
-		std::string m_shader;
+		ShaderHandle m_particle_shader;
+		FireParticleShader m_particle_slots;
 		float m_num_shouldemit_particles;
 		// velocity that particles already have when being sent out (moving source)
 		SimpleVec3d m_init_vel;
 };
 
-/// Single FireParticle, a particle object that can be colored with a shader
-class FireParticle : public PhysicalObject
+/**
+ * \brief Single FireParticle, a particle object that can be colored with a shader
+ *
+ * Moved by the kinematics system of the WorldEnvironment's EntityStore.
+ */
+class FireParticle : public WorldObject
 {
 	public:
-		FireParticle(SimpleVec3d pos, SimpleVec3d vel, std::string shader, float size,
+		FireParticle(SimpleVec3d pos, SimpleVec3d vel, FireParticleShader shader, float size,
 			float exptime);
 		~FireParticle();
 
 		void render();
 		void step(float dtime);
+		void stepMainThread(float dtime);
 
 	private:
+		Entity m_entity;
 		GLfloat m_vertices[4][2];
 		GLubyte m_indices [4];
 
-		std::string m_shader;
+		FireParticleShader m_slots;
 		float m_time;
 		float m_size;
 		float m_exptime;
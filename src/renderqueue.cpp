@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <string.h>
+
+#include "renderqueue.hpp"
+#include "objects.hpp"
+
+#define KEY_PASS_BITS		2
+#define KEY_SHADER_BITS		12
+#define KEY_MATERIAL_BITS	12
+#define KEY_DEPTH_BITS		24
+
+#define KEY_MASK(bits) ((uint64_t(1) << (bits)) - 1)
+
+/**
+ * \brief Removes all items, but keeps the allocated storage for the next frame
+ */
+void RenderQueue::clear()
+{
+	m_items.clear();
+}
+
+/**
+ * \brief Adds an object to the queue
+ * \param obj The object to render
+ * \param relpos The position of the object relative to the player
+ * \param pass The render_pass to draw the object in
+ * \param translucent True if the object uses blending and must be drawn back-to-front
+ * \param shader The ID of the shader the object is drawn with
+ * \param material The material group of the object
+ */
+void RenderQueue::push(WorldObject *obj, SimpleVec3d relpos, uint8_t pass, bool translucent,
+		uint16_t shader, uint16_t material)
+{
+	RenderItem item;
+	item.key = makeKey(pass, translucent, shader, material, getVectorLength(relpos));
+	item.obj = obj;
+	item.relpos = relpos;
+	item.shader = shader;
+	item.material = material;
+
+	m_items.push_back(item);
+}
+
+/**
+ * \brief Sorts all items by their key, see RenderQueue for the resulting order
+ */
+void RenderQueue::sort()
+{
+	std::sort(m_items.begin(), m_items.end(),
+		[](const RenderItem &a, const RenderItem &b) { return a.key < b.key; });
+}
+
+/**
+ * \brief Combines all sorting criteria into a single 64-bit key
+ * \param pass The render_pass
+ * \param translucent True if the object must be drawn back-to-front
+ * \param shader The shader ID, only the lower 12 bits are used
+ * \param material The material group, only the lower 12 bits are used
+ * \param depth The distance of the object to the camera
+ */
+uint64_t RenderQueue::makeKey(uint8_t pass, bool translucent, uint16_t shader,
+		uint16_t material, float depth)
+{
+	uint64_t key = (pass & KEY_MASK(KEY_PASS_BITS));
+	key = (key << 1) | (translucent ? 1 : 0);
+
+	uint64_t shd = shader   & KEY_MASK(KEY_SHADER_BITS);
+	uint64_t mat = material & KEY_MASK(KEY_MATERIAL_BITS);
+	uint64_t dpt = quantizeDepth(depth);
+
+	if (!translucent)
+	{
+		// Group by shader, then material, then front-to-back
+		key = (key << KEY_SHADER_BITS)   | shd;
+		key = (key << KEY_MATERIAL_BITS) | mat;
+		key = (key << KEY_DEPTH_BITS)    | dpt;
+	}
+	else
+	{
+		// Strictly back-to-front, shader and material only break ties
+		key = (key << KEY_DEPTH_BITS)    | (KEY_MASK(KEY_DEPTH_BITS) - dpt);
+		key = (key << KEY_SHADER_BITS)   | shd;
+		key = (key << KEY_MATERIAL_BITS) | mat;
+	}
+
+	// Align to the most significant bit, the remaining low bits are unused
+	return key << (64 - KEY_PASS_BITS - 1 - KEY_SHADER_BITS - KEY_MATERIAL_BITS - KEY_DEPTH_BITS);
+}
+
+/**
+ * \brief Maps a non-negative depth to a 24-bit integer that keeps the order
+ *
+ * The bit pattern of a positive IEEE float grows monotonically with its value, so
+ * dropping the lowest mantissa bits gives a logarithmic quantization, which suits the
+ * huge range of distances in the universe.
+ */
+uint32_t RenderQueue::quantizeDepth(float depth)
+{
+	if (!(depth > 0)) return 0; // also catches NaN
+
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+
+	return bits >> (32 - KEY_DEPTH_BITS);
+}
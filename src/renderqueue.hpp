@@ -0,0 +1,67 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "util.hpp"
+
+class WorldObject;
+
+/**
+ * \brief Render pass a RenderItem belongs to
+ *
+ * The pass is the most significant part of the sort key, so all items of a lower
+ * pass are drawn before any item of a higher pass.
+ */
+enum render_pass
+{
+	RENDER_PASS_WORLD = 0	/** Regular objects in the WorldEnvironment */
+};
+
+/// Single entry of the RenderQueue, an object to draw with its precomputed sort key
+struct RenderItem
+{
+	uint64_t key;
+	WorldObject *obj;
+	SimpleVec3d relpos;	// position relative to the player
+	uint16_t shader;	// shader ID as returned by ShaderManager::getShaderID
+	uint16_t material;	// material group, see render_material in objects.hpp
+};
+
+/**
+ * \brief Collects WorldObjects to render and sorts them by 64-bit sort keys
+ *
+ * Sort key layout, from the most significant bit on:
+ * - opaque:      pass (2) | translucent = 0 (1) | shader (12) | material (12) | depth (24)
+ * - translucent: pass (2) | translucent = 1 (1) | inverted depth (24) | shader (12) | material (12)
+ *
+ * So opaque objects are grouped by shader and material and drawn front-to-back in
+ * each group (which helps early depth rejection), while translucent objects are drawn
+ * strictly back-to-front after all opaque ones.
+ */
+class RenderQueue
+{
+	public:
+		RenderQueue() {};
+
+		void clear();
+		void push(WorldObject *obj, SimpleVec3d relpos, uint8_t pass, bool translucent,
+			uint16_t shader, uint16_t material);
+		void sort();
+
+		/// Retrieve the (sorted) items, valid until clear() is called
+		std::vector<RenderItem> &getItems()
+			{ return m_items; }
+
+		static uint64_t makeKey(uint8_t pass, bool translucent, uint16_t shader,
+			uint16_t material, float depth);
+
+	private:
+		static uint32_t quantizeDepth(float depth);
+
+		// Kept between frames so that the storage is only allocated once
+		std::vector<RenderItem> m_items;
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "rendertarget.hpp"
+#include "glstate.hpp"
+
+/// Creates an empty RenderTarget, OpenGL objects are created by the first resize()
+RenderTarget::RenderTarget() :
+m_fbo(0),
+m_texture(0),
+m_depth(0),
+m_width(0),
+m_height(0)
+{
+}
+
+/// Deletes the OpenGL objects, must be called while the OpenGL context is current
+RenderTarget::~RenderTarget()
+{
+	if (m_fbo != 0) glDeleteFramebuffers(1, &m_fbo);
+	if (m_depth != 0) glDeleteRenderbuffers(1, &m_depth);
+	if (m_texture != 0) GLState::deleteTextures(1, &m_texture);
+}
+
+/**
+ * \brief Returns true if the driver can render to textures (framebuffer objects)
+ */
+bool RenderTarget::isSupported()
+{
+	return GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object;
+}
+
+/**
+ * \brief (Re-)allocates the texture and the depth buffer, leaves the framebuffer bound
+ * \param width The width in pixels
+ * \param height The height in pixels
+ */
+void RenderTarget::resize(int width, int height)
+{
+	if (m_fbo == 0)
+	{
+		glGenFramebuffers(1, &m_fbo);
+		glGenRenderbuffers(1, &m_depth);
+		glGenTextures(1, &m_texture);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+	GLState::bindTexture(m_texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_texture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+
+	m_width = width;
+	m_height = height;
+}
+
+/**
+ * \brief Redirects rendering into the framebuffer, resize() must have been called before
+ */
+void RenderTarget::bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+}
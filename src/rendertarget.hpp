@@ -0,0 +1,39 @@
+#ifndef _RENDERTARGET_H
+#define _RENDERTARGET_H
+
+#include "gllibs.hpp"
+
+/**
+ * \brief Framebuffer object with a color texture and a depth buffer
+ *
+ * The OpenGL objects are created by the first resize(). The texture is linearly filtered
+ * and clamped, so that it can be drawn stretched onto a quad.
+ */
+class RenderTarget
+{
+	public:
+		RenderTarget();
+		~RenderTarget();
+
+		static bool isSupported();
+
+		void resize(int width, int height);
+		void bind();
+
+		/// The color texture, 0 before the first resize()
+		GLuint getTexture()
+			{ return m_texture; }
+
+		int getWidth()
+			{ return m_width; }
+		int getHeight()
+			{ return m_height; }
+
+	private:
+		GLuint m_fbo;
+		GLuint m_texture;
+		GLuint m_depth;
+		int m_width, m_height;
+};
+
+#endif
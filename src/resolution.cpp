@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+#include "resolution.hpp"
+#include "glstate.hpp"
+#include "gamevars.hpp"
+#include "config.hpp"
+
+// Time in seconds between two adjustments of the scale
+#define RESOLUTION_ADJUST_INTERVAL 0.5
+
+/*
+	The scale is lowered if the average frame time exceeds the target by
+	RESOLUTION_TOLERANCE_HIGH and raised if it is below RESOLUTION_TOLERANCE_LOW times
+	the target; in between it is kept, so that it does not toggle between two values
+*/
+#define RESOLUTION_TOLERANCE_HIGH 1.1
+#define RESOLUTION_TOLERANCE_LOW 0.8
+
+// Scales are rounded to multiples of this
+#define RESOLUTION_STEP 0.05
+
+/**
+ * \brief Reads the configuration, the framebuffer is created by the first begin()
+ */
+ResolutionScaler::ResolutionScaler() :
+m_enabled(config->getBool("dynamic_resolution", false)),
+m_target(config->getDouble("target_frame_time", 33) / 1000.),
+m_min_scale(config->getDouble("dynamic_resolution_min", 0.3)),
+m_scale(1.0),
+m_last_adjust(std::chrono::steady_clock::now()),
+m_frametime_sum(0),
+m_frames(0),
+m_render_w(0),
+m_render_h(0)
+{
+	if (m_enabled && !RenderTarget::isSupported())
+	{
+		std::cout << "Dynamic resolution requires framebuffer objects, disabled" << std::endl;
+		m_enabled = false;
+	}
+}
+
+/**
+ * \brief Adapts the scale to the average frame time since the last adjustment
+ * \param worktime The time spent on the frame, without pacing or vsync (see
+ * FramePacer::getWorkTime())
+ *
+ * To be called once per frame, before the buffer swap. The frame time is assumed to
+ * be dominated by the fill rate, i.e. proportional to the squared scale.
+ */
+void ResolutionScaler::addFrameTime(double worktime)
+{
+	if (!m_enabled) return;
+
+	auto now = std::chrono::steady_clock::now();
+	m_frametime_sum += worktime;
+	m_frames++;
+
+	if (std::chrono::duration<double>(now - m_last_adjust).count() < RESOLUTION_ADJUST_INTERVAL)
+		return;
+
+	double frametime = m_frametime_sum / m_frames;
+	m_last_adjust = now;
+	m_frametime_sum = 0;
+	m_frames = 0;
+
+	if (frametime < m_target * RESOLUTION_TOLERANCE_HIGH
+			&& frametime > m_target * RESOLUTION_TOLERANCE_LOW)
+		return;
+
+	float scale = m_scale * sqrt(m_target / frametime);
+	scale = round(scale / RESOLUTION_STEP) * RESOLUTION_STEP;
+	scale = std::max(m_min_scale, std::min(1.0f, scale));
+
+	if (scale != m_scale)
+	{
+		std::cout << "Dynamic resolution: frame time " << frametime * 1000 << " ms, scale "
+			<< m_scale << " -> " << scale << std::endl;
+		m_scale = scale;
+	}
+}
+
+/**
+ * \brief Redirects rendering into the offscreen framebuffer, if enabled
+ * \param window_w The window width
+ * \param window_h The window height
+ * \param render_w Returns the width to render the world with
+ * \param render_h Returns the height to render the world with
+ *
+ * Also clears the used part of the framebuffer. If disabled, render_w and render_h are
+ * the window size and nothing else happens.
+ */
+void ResolutionScaler::begin(int window_w, int window_h, int &render_w, int &render_h)
+{
+	render_w = window_w;
+	render_h = window_h;
+	if (!m_enabled) return;
+
+	if (window_w != m_framebuffer.getWidth() || window_h != m_framebuffer.getHeight())
+		m_framebuffer.resize(window_w, window_h);
+
+	m_render_w = render_w = std::max(1, (int)(window_w * m_scale));
+	m_render_h = render_h = std::max(1, (int)(window_h * m_scale));
+
+	m_framebuffer.bind();
+	glViewport(0, 0, m_render_w, m_render_h);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/**
+ * \brief Stretches the rendered world over the window, if enabled
+ * \param window_w The window width
+ * \param window_h The window height
+ */
+void ResolutionScaler::end(int window_w, int window_h)
+{
+	if (!m_enabled) return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, window_w, window_h);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	GLState::enable(GL_TEXTURE_2D);
+	GLState::bindTexture(m_framebuffer.getTexture());
+	glColor4f(1, 1, 1, 1);
+
+	float u = (float)m_render_w / m_framebuffer.getWidth();
+	float v = (float)m_render_h / m_framebuffer.getHeight();
+	glBegin(GL_QUADS);
+		glTexCoord2f(0, 0); glVertex2f(-1, -1);
+		glTexCoord2f(u, 0); glVertex2f( 1, -1);
+		glTexCoord2f(u, v); glVertex2f( 1,  1);
+		glTexCoord2f(0, v); glVertex2f(-1,  1);
+	glEnd();
+
+	GLState::disable(GL_TEXTURE_2D);
+}
@@ -0,0 +1,52 @@
+#ifndef _RESOLUTION_H
+#define _RESOLUTION_H
+
+#include <stdint.h>
+#include <chrono>
+
+#include "rendertarget.hpp"
+#include "gllibs.hpp"
+
+/**
+ * \brief Renders the 3D world at a reduced resolution to hold a target frame time
+ *
+ * Between begin() and end(), rendering goes to an offscreen framebuffer of window size,
+ * of which only the scaled part is used. end() stretches that part over the window, so
+ * that the HUD can be drawn at full resolution afterwards. The scale is adapted every
+ * RESOLUTION_ADJUST_INTERVAL to the average frame time passed to addFrameTime(), as the
+ * fill rate is proportional to the number of pixels.
+ */
+class ResolutionScaler
+{
+	public:
+		ResolutionScaler();
+
+		/// True if the world is rendered offscreen, see begin()
+		bool getEnabled()
+			{ return m_enabled; }
+
+		/// The current scale of the width and height, 1.0 is the window resolution
+		float getScale()
+			{ return m_scale; }
+
+		void begin(int window_w, int window_h, int &render_w, int &render_h);
+		void end(int window_w, int window_h);
+		void addFrameTime(double worktime);
+
+	private:
+
+		bool m_enabled;
+		float m_target;		// target frame time in seconds
+		float m_min_scale;
+		float m_scale;
+
+		// Average frame time since the last adjustment of the scale
+		std::chrono::steady_clock::time_point m_last_adjust;
+		double m_frametime_sum;
+		uint32_t m_frames;
+
+		RenderTarget m_framebuffer;	// of window size
+		int m_render_w, m_render_h;	// used part of the framebuffer
+};
+
+#endif
@@ -1,23 +1,39 @@
 #include <iostream>
 #include <dirent.h>
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <fstream>
+#include <chrono>
+#include <thread>
 #include <sstream>
 #include <string>
 
 #include "gllibs.hpp"
 
 #include "gamevars.hpp"
+#include "glstate.hpp"
 #include "shader.hpp"
 #include "config.hpp"
 #include "util.hpp"
+#include "splash.hpp"
+#include "camera.hpp"
 #include "game.hpp"
 
+// Minimum time between two redraws of the loading progress, in milliseconds
+#define SHADER_PROGRESS_INTERVAL 50
+
 /*
 	Shader Class
 */
 
+/// Compares type and value of two uniform values
+bool ShaderUniformValue::operator==(const ShaderUniformValue &other) const
+{
+	return type == other.type && f[0] == other.f[0] && f[1] == other.f[1]
+		&& f[2] == other.f[2] && i == other.i;
+}
+
 /**
  * \brief Output formatted debug information on failure and exit game
  * \param filename The shader's filename the bug was discovered in
@@ -36,11 +52,13 @@ void Shader::throwError(std::string filename, GLuint shader)
 	*/
 
 	// Get line number of prepended shader string to subtract it later
-	uint16_t prepend_linenum = 1;
-	std::ifstream prependstream(m_prepend);
+	GLint shader_type;
+	glGetShaderiv(shader, GL_SHADER_TYPE, &shader_type);
+	std::string prepend = getPrepend(shader_type);
 
-	for (uint16_t i = 0; i<m_prepend.length(); ++i)
-		if (m_prepend[i] == '\n') ++prepend_linenum;
+	uint16_t prepend_linenum = 1;
+	for (uint16_t i = 0; i<prepend.length(); ++i)
+		if (prepend[i] == '\n') ++prepend_linenum;
 
 	char errorlog_c[4096];
 	glGetShaderInfoLog(shader, 4096, nullptr, errorlog_c);
@@ -74,74 +92,287 @@ void Shader::throwError(std::string filename, GLuint shader)
 }
 
 /**
- * \brief Creates and compiler a single shader from the file at filename
- * \param filename The GLSL file to compile
+ * \brief Returns the builtin shader code to prepend to a shader of the given type
+ * \param shader_type GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+ *
+ * Vertex shaders additionally get VERTEX_SHADER defined right after the #version line,
+ * so that the builtin shader can provide functions that are only valid in that stage.
+ */
+std::string Shader::getPrepend(GLenum shader_type)
+{
+	if (shader_type != GL_VERTEX_SHADER) return m_prepend;
+
+	std::string prepend = m_prepend;
+	size_t version_end = prepend.find('\n') + 1;
+	prepend.insert(version_end, "#define VERTEX_SHADER\n");
+
+	return prepend;
+}
+
+/**
+ * \brief Reads a single shader from the file at filename and prepends the builtin shader
+ * \param filename The GLSL file to read
  *
  * Detects whether vertex or fragment shader by the file name extension:
  * .glslf = Fragment shader, .glslv = Vertex shader
  */
-GLuint Shader::importShader(std::string filename)
+ShaderSource Shader::readShader(std::string filename)
 {
-	GLuint shaderid;
+	ShaderSource source;
+	source.filename = filename;
 
 	std::ifstream src;
 	std::stringstream srcbuf;
-	std::string srcstr;
-
-	src.open(getBasedir() + SHADER_DIR + filename);
-	srcbuf << src.rdbuf();
-	srcstr = srcbuf.str();
-	srcstr = m_prepend + srcstr; // prepend builtin shader
 
 	std::string fn_ext;
 	fn_ext = filename.substr(filename.length()-5, 5);
 
-	GLenum shader_type;
 	if (fn_ext == "glslf")
-		shader_type = GL_FRAGMENT_SHADER;
+		source.type = GL_FRAGMENT_SHADER;
 	else if (fn_ext == "glslv")
-		shader_type = GL_VERTEX_SHADER;
+		source.type = GL_VERTEX_SHADER;
 	else
 	{
 		std::cout<<"Shader with invalid filename extension, exiting: "<<filename<<std::endl;
 		std::exit(EXIT_FAILURE);
 	}
 
-	shaderid = glCreateShader(shader_type);
-	const char * srcchar = srcstr.c_str();
+	src.open(getBasedir() + SHADER_DIR + filename);
+	srcbuf << src.rdbuf();
+	source.source = getPrepend(source.type) + srcbuf.str(); // prepend builtin shader
+
+	return source;
+}
+
+/**
+ * \brief Creates a single shader and starts compiling it
+ * \param source The shader as returned by readShader()
+ *
+ * Does not wait for the compiler, see finishLoad().
+ */
+GLuint Shader::importShader(const ShaderSource &source)
+{
+	GLuint shaderid = glCreateShader(source.type);
+	const char * srcchar = source.source.c_str();
 	glShaderSource(shaderid, 1, &srcchar, NULL);
 
 	glCompileShader(shaderid);
-	GLint compile_status;
-	glGetShaderiv(shaderid, GL_COMPILE_STATUS, &compile_status);
-
-	if (compile_status == GL_FALSE) // Shader compilation failed, get Debug information
-		throwError(filename, shaderid);
 
 	return shaderid;
 }
 
 /**
- * \brief Compiles and links the shader.
+ * \brief Starts compiling and linking the shaders, or loads the program from the binary cache
+ * \param sources All shaders of the program
  *
- * Uses Shader::importShader as helper function.
+ * If the binary cache is enabled (m_cache_key is not empty) and contains a binary for exactly
+ * these sources and this driver, the program is loaded from it instead of being compiled.
+ * Otherwise, the shaders are only submitted to the driver, finishLoad() checks the result.
  */
-void Shader::loadShader()
+void Shader::submit(std::vector<ShaderSource> &sources)
 {
-	GLuint shaderid = importShader(m_filename);
+	std::sort(sources.begin(), sources.end(),
+		[](const ShaderSource &a, const ShaderSource &b) { return a.filename < b.filename; });
+
+	// FNV-1a hash of the driver and all sources
+	m_hash = 14695981039346656037ULL;
+	auto addToHash = [this](const std::string &str)
+	{
+		for (size_t i = 0; i <= str.length(); ++i) // including the terminating 0
+		{
+			m_hash ^= (uint8_t)str.c_str()[i];
+			m_hash *= 1099511628211ULL;
+		}
+	};
+	addToHash(m_cache_key);
+	for (auto &source : sources)
+	{
+		addToHash(source.filename);
+		addToHash(source.source);
+	}
+
+	m_from_cache = !m_cache_key.empty() && loadBinary(m_hash);
+	if (m_from_cache) return;
+
+	for (auto &source : sources)
+	{
+		m_compiling.push_back(std::make_pair(source.filename, importShader(source)));
+	}
 
 	m_id = glCreateProgram();
-	glAttachShader(m_id, shaderid);
+	for (auto &shader : m_compiling)
+	{
+		glAttachShader(m_id, shader.second);
+	}
 
+	if (!m_cache_key.empty())
+		glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(m_id);
 }
 
+/**
+ * \brief Returns false while the driver is still compiling the shader in the background
+ *
+ * Only works if the driver supports GL_KHR_parallel_shader_compile or
+ * GL_ARB_parallel_shader_compile, always returns true otherwise.
+ */
+bool Shader::getLoadCompleted()
+{
+	if (m_compiling.empty()) return true;
+	if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile) return true;
+
+	GLint completed = GL_TRUE;
+	glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &completed);
+	return completed == GL_TRUE;
+}
+
+/**
+ * \brief Waits for the program submitted by submit(), checks it and prepares it for use
+ *
+ * Exits with the compiler output if a shader could not be compiled. Newly linked programs
+ * are written to the binary cache.
+ */
+void Shader::finishLoad()
+{
+	if (!m_compiling.empty())
+	{
+		for (auto &shader : m_compiling)
+		{
+			GLint compile_status;
+			glGetShaderiv(shader.second, GL_COMPILE_STATUS, &compile_status);
+
+			if (compile_status == GL_FALSE) // compilation failed, get Debug information
+				throwError(shader.first, shader.second);
+		}
+
+		// The program keeps the compiled code, the shaders are not needed anymore
+		for (auto &shader : m_compiling)
+		{
+			glDetachShader(m_id, shader.second);
+			glDeleteShader(shader.second);
+		}
+		m_compiling.clear();
+
+		if (!m_cache_key.empty())
+			saveBinary(m_hash);
+	}
+
+	resolveUniforms();
+}
+
+/// Returns the path of the binary cache file of the shader
+std::string Shader::getBinaryPath()
+{
+	return getBasedir() + SHADER_CACHE_DIR + m_filename + ".bin";
+}
+
+/**
+ * \brief Creates the program from the binary cache, if the cache is valid
+ * \param hash The hash of the driver and sources the cached binary must have been built from
+ *
+ * Returns false if there is no cached binary, if it has been built from other sources or if the
+ * driver rejects it (e.g. after a driver update). m_id is not a valid program then.
+ */
+bool Shader::loadBinary(uint64_t hash)
+{
+	std::ifstream file(getBinaryPath(), std::ios::binary);
+	if (!file) return false;
+
+	uint64_t file_hash;
+	uint32_t format, length;
+	file.read((char *)&file_hash, sizeof(file_hash));
+	file.read((char *)&format, sizeof(format));
+	file.read((char *)&length, sizeof(length));
+	if (!file || file_hash != hash) return false;
+
+	std::vector<char> binary(length);
+	file.read(&binary[0], length);
+	if (!file) return false;
+
+	m_id = glCreateProgram();
+	glProgramBinary(m_id, format, &binary[0], length);
+
+	GLint link_status;
+	glGetProgramiv(m_id, GL_LINK_STATUS, &link_status);
+	if (link_status == GL_FALSE)
+	{
+		std::cout<<"|- Cached binary rejected by the driver, compiling"<<std::endl;
+		glDeleteProgram(m_id);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * \brief Writes the linked program to the binary cache
+ * \param hash The hash of the driver and sources the program has been built from
+ */
+void Shader::saveBinary(uint64_t hash)
+{
+	GLint length = 0;
+	glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(m_id, length, nullptr, &format, &binary[0]);
+
+	std::ofstream file(getBinaryPath(), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cout<<"|- Could not write shader cache file "<<getBinaryPath()<<std::endl;
+		return;
+	}
+
+	uint32_t format32 = format, length32 = length;
+	file.write((const char *)&hash, sizeof(hash));
+	file.write((const char *)&format32, sizeof(format32));
+	file.write((const char *)&length32, sizeof(length32));
+	file.write(&binary[0], length);
+}
+
+/**
+ * \brief Compiles and links the shader.
+ *
+ * Uses submitShader() and finishLoad().
+ */
+void Shader::loadShader()
+{
+	submitShader();
+	finishLoad();
+}
+
 /**
  * \brief Imports a shader group
  *
  * A shader group are a vertex and a fragments shader in a single folder that are linked together.
+ * Uses submitShaderGroup() and finishLoad().
  */
 void Shader::loadShaderGroup()
+{
+	submitShaderGroup();
+	finishLoad();
+}
+
+/**
+ * \brief Submits the shader to the driver, like loadShader(), but without waiting for it
+ *
+ * finishLoad() must be called before the shader can be used.
+ */
+void Shader::submitShader()
+{
+	std::vector<ShaderSource> sources;
+	sources.push_back(readShader(m_filename));
+	submit(sources);
+}
+
+/**
+ * \brief Submits the shader group to the driver, like loadShaderGroup(), but without waiting
+ *
+ * finishLoad() must be called before the shader can be used.
+ */
+void Shader::submitShaderGroup()
 {
 	DIR *dir;
 	struct dirent *file;
@@ -149,7 +380,7 @@ void Shader::loadShaderGroup()
 	dir = opendir((getBasedir() + SHADER_DIR + m_filename).c_str());
 	assert(dir);
 
-	std::vector<GLuint> shaderids;
+	std::vector<ShaderSource> sources;
 
 	while (( file = readdir(dir) ))
 	{
@@ -159,91 +390,234 @@ void Shader::loadShaderGroup()
 
 		std::string shaderfile = m_filename + DIR_DELIM + file->d_name;
 		std::cout<<"|- Group Shader: "<<file->d_name<<std::endl;
-		shaderids.push_back(importShader(shaderfile));
+		sources.push_back(readShader(shaderfile));
 	}
 
-	m_id = glCreateProgram();
-	for (auto shaderid : shaderids)
+	closedir(dir);
+
+	submit(sources);
+}
+
+/**
+ * \brief Looks up the locations of all active uniforms of the linked program
+ *
+ * Every uniform gets a slot, which is its index in m_uniforms. The locations are never looked up
+ * by name again afterwards.
+ */
+void Shader::resolveUniforms()
+{
+	GLint uniformnum = 0;
+	glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &uniformnum);
+
+	for (GLint i = 0; i < uniformnum; ++i)
 	{
-		glAttachShader(m_id, shaderid);
+		char name_c[256];
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(m_id, i, sizeof(name_c), nullptr, &size, &type, name_c);
+
+		// Arrays are reported as name[0]
+		std::string name(name_c);
+		size_t bracket = name.find('[');
+		if (bracket != std::string::npos) name.erase(bracket);
+
+		// Builtin uniforms such as gl_ModelViewMatrix have no location
+		GLint location = glGetUniformLocation(m_id, name.c_str());
+		if (location == -1) continue;
+
+		ShaderUniform uniform;
+		uniform.name = name;
+		uniform.location = location;
+		uniform.pending = false;
+		uniform.transferred = false;
+		m_uniforms.push_back(uniform);
 	}
 
-	glLinkProgram(m_id);
+	m_pending.reserve(m_uniforms.size());
+
+	m_time_slot = getUniformSlot("time");
+	m_usc_slot  = getUniformSlot("usc");
+	m_seed_slot = getUniformSlot("seed");
 }
 
 /**
  * \brief Uses the requested shader
+ * \param bind False if the program is already in use, only transfers the parameters then
  *
- * Calls glUseProgram() for the shader object
+ * Calls glUseProgram() for the shader object and transfers the uniforms that have been set since
+ * the last call, unless they still have the same value in the program.
  */
-void Shader::use()
+void Shader::use(bool bind)
 {
-	glUseProgram(m_id);
+	if (bind)
+		GLState::useProgram(m_id);
 
-	GLint time_loc = glGetUniformLocation(m_id, "time");
-	if (time_loc != -1)
-		glUniform1f(time_loc, game->getUniverseTime());
+	// Builtin uniforms, unless they have been set explicitly
+	if (m_time_slot != SHADER_NO_SLOT && !m_uniforms[m_time_slot].pending)
+		setUniformf(m_time_slot, game->getUniverseTime());
 
-	GLint usc_loc = glGetUniformLocation(m_id, "usc");
-	if (usc_loc != -1)
-		glUniform1f(usc_loc, USC);
+	if (m_usc_slot != SHADER_NO_SLOT && !m_uniforms[m_usc_slot].pending)
+		setUniformf(m_usc_slot, USC);
 
-	GLint seed_loc = glGetUniformLocation(m_id, "seed");
-	if (seed_loc != -1)
-		glUniform1i(seed_loc, game->getSeed());
+	if (m_seed_slot != SHADER_NO_SLOT && !m_uniforms[m_seed_slot].pending)
+		setUniformi(m_seed_slot, game->getSeed());
 
-	for (auto parami : m_parameters_i)
+	for (auto slot : m_pending)
 	{
-		GLint piloc = glGetUniformLocation(m_id, parami.first.c_str());
-		glUniform1i(piloc, parami.second);
-	}	
+		ShaderUniform &uniform = m_uniforms[slot];
+		uniform.pending = false;
 
-	for (auto param3f : m_parameters_3f)
+		if (uniform.transferred && uniform.current == uniform.value)
+			continue;
+
+		switch (uniform.value.type)
+		{
+			case GL_FLOAT_VEC3:
+				glUniform3fv(uniform.location, 1, uniform.value.f);
+				break;
+			case GL_FLOAT:
+				glUniform1f(uniform.location, uniform.value.f[0]);
+				break;
+			default:
+				glUniform1i(uniform.location, uniform.value.i);
+		}
+
+		uniform.current = uniform.value;
+		uniform.transferred = true;
+	}
+
+	// pending values need to be set again before every use() call
+	m_pending.clear();
+}
+
+/**
+ * \brief Returns the slot of a uniform, for the setUniform* functions
+ * \param name The name of the uniform in the shader
+ *
+ * Returns SHADER_NO_SLOT if the shader does not use the uniform. Slots never change, so they should
+ * be looked up once and not every time the shader is used.
+ */
+int16_t Shader::getUniformSlot(std::string name)
+{
+	for (uint16_t i = 0; i < m_uniforms.size(); ++i)
 	{
-		GLint p3floc = glGetUniformLocation(m_id, param3f.first.c_str());
-		glUniform3f(p3floc, param3f.second[0], param3f.second[1], param3f.second[2]);
+		if (m_uniforms[i].name == name)
+			return i;
 	}
 
-	for (auto paramf : m_parameters_f)
+	return SHADER_NO_SLOT;
+}
+
+/**
+ * \brief Sets a uniform, it will be transferred next time the shader is used
+ * \param slot The slot as returned by getUniformSlot()
+ * \param value The value to write to it
+ */
+void Shader::setUniform(int16_t slot, const ShaderUniformValue &value)
+{
+	if (slot == SHADER_NO_SLOT) return;
+
+	ShaderUniform &uniform = m_uniforms[slot];
+	if (!uniform.pending)
 	{
-		GLint pfloc = glGetUniformLocation(m_id, paramf.first.c_str());
-		glUniform1f(pfloc, paramf.second);
+		uniform.pending = true;
+		m_pending.push_back(slot);
 	}
 
-	// clear parameters, need to be resent after every use() call
-	m_parameters_3f.clear();
-	m_parameters_f.clear();
-	m_parameters_i.clear();
+	uniform.value = value;
+}
+
+/**
+ * \brief Sets a vec3 uniform, it will be transferred next time the shader is used
+ * \param slot The slot as returned by getUniformSlot()
+ * \param value The three components, copied immediately
+ */
+void Shader::setUniform3f(int16_t slot, const GLfloat *value)
+{
+	ShaderUniformValue uniform;
+	uniform.type = GL_FLOAT_VEC3;
+	uniform.f[0] = value[0];
+	uniform.f[1] = value[1];
+	uniform.f[2] = value[2];
+	uniform.i = 0;
+	setUniform(slot, uniform);
+}
+
+/**
+ * \brief Sets a float uniform, it will be transferred next time the shader is used
+ * \param slot The slot as returned by getUniformSlot()
+ * \param value The value to write to it
+ */
+void Shader::setUniformf(int16_t slot, GLfloat value)
+{
+	ShaderUniformValue uniform;
+	uniform.type = GL_FLOAT;
+	uniform.f[0] = value;
+	uniform.f[1] = uniform.f[2] = 0;
+	uniform.i = 0;
+	setUniform(slot, uniform);
+}
+
+/**
+ * \brief Sets an integer uniform, it will be transferred next time the shader is used
+ * \param slot The slot as returned by getUniformSlot()
+ * \param value The value to write to it
+ */
+void Shader::setUniformi(int16_t slot, GLint value)
+{
+	ShaderUniformValue uniform;
+	uniform.type = GL_INT;
+	uniform.f[0] = uniform.f[1] = uniform.f[2] = 0;
+	uniform.i = value;
+	setUniform(slot, uniform);
 }
 
 /**
  * \brief Adds a vec3 parameter for the shader. Will be transferred next time the shader is used.
  * \param name The variable name (location) to put the value in the shader.
  * \param param The value to write to it.
+ *
+ * Looks up the slot by name, objects that use the shader every frame should use getUniformSlot()
+ * once and setUniform3f() instead.
  */
 void Shader::addParameter3f(std::string name, GLfloat *param)
 {
-	m_parameters_3f.push_back(std::pair<std::string, GLfloat*>(name, param));
+	setUniform3f(getUniformSlot(name), param);
 }
 
 /**
  * \brief Adds a float parameter for the shader. Will be transferred next time the shader is used.
  * \param name The variable name (location) to put the value in the shader.
  * \param param The value to write to it.
+ *
+ * Looks up the slot by name, see addParameter3f().
  */
 void Shader::addParameterf(std::string name, GLfloat param)
 {
-	m_parameters_f.push_back(std::pair<std::string, GLfloat>(name, param));
+	setUniformf(getUniformSlot(name), param);
 }
 
 /**
  * \brief Adds an integer parameter for the shader. Will be transferred next time the shader is used.
  * \param name The variable name (location) to put the value in the shader.
  * \param param The value to write to it.
+ *
+ * Looks up the slot by name, see addParameter3f().
  */
 void Shader::addParameteri(std::string name, GLint param)
 {
-	m_parameters_i.push_back(std::pair<std::string, GLint>(name, param));
+	setUniformi(getUniformSlot(name), param);
+}
+
+/**
+ * \brief Returns the location of a vertex attribute, e.g. for an InstanceBuffer
+ * \param name The name of the attribute in the vertex shader
+ *
+ * Returns -1 if the shader does not use the attribute.
+ */
+GLint Shader::getAttribLocation(std::string name)
+{
+	return glGetAttribLocation(m_id, name.c_str());
 }
 
 
@@ -257,9 +631,16 @@ void Shader::addParameteri(std::string name, GLint param)
  * All shaders are compiled by this function when the game is started. This automatically handles
  * shaders groups and prepending the builtin shader. Shaders have to be in <basedir>/SHADER_DIR,
  * builtin shader at <basedir>/BUILTIN_SHADER_PATH.
+ *
+ * If shader_cache is enabled and the driver supports program binaries, linked programs are
+ * stored in <basedir>/SHADER_CACHE_DIR and loaded from there on the next start.
  */
-ShaderManager::ShaderManager ()
+ShaderManager::ShaderManager () :
+m_default(nullptr),
+m_current(nullptr)
 {
+	auto starttime = std::chrono::steady_clock::now();
+
 	std::cout << std::endl;
 	std::cout << "###############" << std::endl;
 	std::cout << "### SHADERS ###" << std::endl;
@@ -281,8 +662,29 @@ ShaderManager::ShaderManager ()
 	builtin_buf << builtin_src.rdbuf();
 	builtin_str = builtin_buf.str();
 
+	// Binaries are only valid for the driver that created them
+	std::string cache_key;
+	GLint binary_formats = 0;
+	if (GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binary_formats);
+
+	if (config->getBool("shader_cache", true) && binary_formats > 0
+			&& makeDirectory(getBasedir() + SHADER_CACHE_DIR))
+	{
+		cache_key = std::string((const char *)glGetString(GL_VENDOR)) + "\n"
+			+ (const char *)glGetString(GL_RENDERER) + "\n"
+			+ (const char *)glGetString(GL_VERSION);
+	}
+
+	// Let the driver compile in as many threads as it likes
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLEW_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+
 	DIR *dir;
 	struct dirent *file;
+	std::vector<Shader *> loading;
 
 	dir = opendir((getBasedir() + SHADER_DIR).c_str());
 	assert(dir);
@@ -295,12 +697,13 @@ ShaderManager::ShaderManager ()
 		if (firstchar != '.' && lastchar != '~') // not .. ; not . ; not .hidden ; not hidden~
 		{
 			std::string filepath = getBasedir() + SHADER_DIR + std::string(file->d_name);
-			Shader *s = new Shader(std::string(file->d_name), builtin_str);
+			Shader *s = new Shader(std::string(file->d_name), builtin_str, cache_key);
 			if(opendir(filepath.c_str()))	// must be shader group,
 							// glslv + glslf shader in a folder
 			{
 				std::cout <<	"Found Shader Group: " << file->d_name << std::endl;
-				s->loadShaderGroup();
+				s->submitShaderGroup();
+				loading.push_back(s);
 			}
 
 			m_shaders.push_back(s);
@@ -308,6 +711,52 @@ ShaderManager::ShaderManager ()
 	}
 
 	closedir (dir);
+
+	/*
+		All shaders have been submitted, the driver may compile them in the background
+		meanwhile (e.g. Mesa's compiler threads). Show the progress on the splash screen,
+		but not more often than every SHADER_PROGRESS_INTERVAL milliseconds, as every
+		redraw may wait for vsync.
+	*/
+	auto lastprogress = std::chrono::steady_clock::now();
+	auto showProgress = [&lastprogress](float progress)
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastprogress < std::chrono::milliseconds(SHADER_PROGRESS_INTERVAL)) return;
+		drawSplashProgress(progress);
+		lastprogress = now;
+	};
+
+	// Without parallel compilation, the shaders are completed one by one in finishLoad()
+	uint16_t completed_num;
+	do
+	{
+		completed_num = 0;
+		for (auto s : loading)
+			if (s->getLoadCompleted()) completed_num++;
+
+		showProgress(0.5 * completed_num / loading.size());
+		if (completed_num < loading.size())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	while (completed_num < loading.size());
+
+	uint16_t cached_num = 0, compiled_num = 0;
+	for (auto s : loading)
+	{
+		s->finishLoad();
+		if (s->getFromCache()) cached_num++;
+		else compiled_num++;
+
+		showProgress(0.5 + 0.5 * (cached_num + compiled_num) / loading.size());
+	}
+
+	m_default = getShader("default");
+
+	std::chrono::duration<double, std::milli> duration =
+		std::chrono::steady_clock::now() - starttime;
+	std::cout << "Loaded " << cached_num << " shaders from cache, compiled " << compiled_num
+		<< " in " << duration.count() << " ms" << std::endl;
 }
 
 /**
@@ -322,7 +771,7 @@ void ShaderManager::requestShader(std::string filename)
 	{
 		if (shader->getFileName() == filename)
 		{
-			shader->use();
+			activate(shader);
 			return; // Shader found
 		}
 	}
@@ -331,6 +780,47 @@ void ShaderManager::requestShader(std::string filename)
 	std::exit(EXIT_FAILURE);
 }
 
+/**
+ * \brief Calls glUseProgram() on the shader with the given ID
+ * \param id The ID as returned by ShaderManager::getShaderID
+ */
+void ShaderManager::requestShader(int16_t id)
+{
+	assert(id >= 0 && id < (int16_t)m_shaders.size());
+	activate(m_shaders[id]);
+}
+
+/**
+ * \brief Returns the ID of a shader, which is stable as long as the ShaderManager exists
+ * \param filename The filename / directory name of the shader
+ *
+ * Looking up the ID once and requesting the shader by ID afterwards avoids comparing
+ * the names every time. Throws error and exits if not found.
+ */
+int16_t ShaderManager::getShaderID(std::string filename)
+{
+	for (uint16_t i = 0; i < m_shaders.size(); ++i)
+	{
+		if (m_shaders[i]->getFileName() == filename)
+			return i;
+	}
+
+	std::cout<<"Error: Shader '"<<filename<<"' not found in getShaderID()!"<<std::endl;
+	std::exit(EXIT_FAILURE);
+}
+
+/**
+ * \brief Uses the shader and transfers its parameters
+ * \param shader The shader to use
+ *
+ * glUseProgram() is only called if the shader is not in use already.
+ */
+void ShaderManager::activate(Shader *shader)
+{
+	shader->use(shader != m_current);
+	m_current = shader;
+}
+
 /**
  * \brief Returns the instance of the requested shader
  * \parameter filename The filename / directory name of the shader to retrieve
@@ -349,11 +839,54 @@ Shader *ShaderManager::getShader(std::string filename)
 	std::exit(EXIT_FAILURE);
 }
 
+/**
+ * \brief Returns the instance of the shader with the given ID
+ * \param id The ID as returned by ShaderManager::getShaderID
+ */
+Shader *ShaderManager::getShader(int16_t id)
+{
+	assert(id >= 0 && id < (int16_t)m_shaders.size());
+	return m_shaders[id];
+}
+
 /**
  * \brief Makes the game only use the default shader again after calling
+ *
+ * Does nothing if the default shader is still in use.
  */
 void ShaderManager::resetShader()
 {
-	glUseProgram(0);
-	requestShader("default");
+	if (m_current != m_default)
+		activate(m_default);
+}
+
+
+/*
+	ShaderHandle Class
+*/
+
+/**
+ * \brief Looks up the shader if that has not happened yet
+ *
+ * Returns true only for the call that looked up the shader, so that the caller can look up the
+ * uniform slots it needs once.
+ */
+bool ShaderHandle::resolve()
+{
+	if (m_shader != nullptr) return false;
+
+	ShaderManager *shaderman = game->getCamera()->getShaderManager();
+	m_id = shaderman->getShaderID(m_name);
+	m_shader = shaderman->getShader(m_id);
+
+	return true;
+}
+
+/**
+ * \brief Uses the shader and transfers its parameters, see ShaderManager::requestShader
+ */
+void ShaderHandle::request()
+{
+	resolve();
+	game->getCamera()->getShaderManager()->requestShader(m_id);
 }
@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <vector>
 #include <string>
 #include "gllibs.hpp"
@@ -5,36 +6,114 @@
 #ifndef _SHADER_H
 #define _SHADER_H
 
+// Slot of a uniform that the shader does not use, setting it has no effect
+#define SHADER_NO_SLOT -1
+
+/// Value of a uniform, as set by the Shader::setUniform* functions
+struct ShaderUniformValue
+{
+	GLenum type;		// GL_FLOAT, GL_FLOAT_VEC3 or GL_INT
+	GLfloat f[3];
+	GLint i;
+
+	bool operator==(const ShaderUniformValue &other) const;
+};
+
+/// An active uniform of a linked Shader, see Shader::getUniformSlot
+struct ShaderUniform
+{
+	std::string name;
+	GLint location;
+	ShaderUniformValue value;	// value set since the last use(), if pending
+	ShaderUniformValue current;	// value that has been transferred to the program
+	bool pending;
+	bool transferred;		// false until a value has been transferred
+};
+
+/// A shader file that has been read, with the builtin shader prepended
+struct ShaderSource
+{
+	std::string filename;
+	GLenum type;
+	std::string source;
+};
+
 /// A single shader group / shader file
 class Shader
 {
 	public:
-		Shader(std::string filename, std::string prepend) :
+		// cache_key identifies the driver for the binary cache, empty to disable the cache
+		Shader(std::string filename, std::string prepend, std::string cache_key = "") :
 		m_filename(filename),
-		m_prepend(prepend) {};
+		m_prepend(prepend),
+		m_cache_key(cache_key),
+		m_from_cache(false),
+		m_hash(0),
+		m_time_slot(SHADER_NO_SLOT),
+		m_usc_slot(SHADER_NO_SLOT),
+		m_seed_slot(SHADER_NO_SLOT) {};
 
 		void loadShader();
 		void loadShaderGroup();
 
-		void use();
+		// Loading in steps, so that the driver can compile several shaders at once
+		void submitShader();
+		void submitShaderGroup();
+		bool getLoadCompleted();
+		void finishLoad();
+
+		void use(bool bind = true);
 
 		std::string getFileName()
 			{ return m_filename; };
 
+		/// True if the program has been loaded from the binary cache instead of compiled
+		bool getFromCache()
+			{ return m_from_cache; };
+
+		int16_t getUniformSlot(std::string name);
+		void setUniform3f(int16_t slot, const GLfloat *value);
+		void setUniformf(int16_t slot, GLfloat value);
+		void setUniformi(int16_t slot, GLint value);
+
 		void addParameter3f(std::string name, GLfloat *param);
 		void addParameterf(std::string name, GLfloat param);
 		void addParameteri(std::string name, GLint param);
 
+		GLint getAttribLocation(std::string name);
+
 	private:
 		void throwError(std::string filename, GLuint shader);
+		std::string getPrepend(GLenum shader_type);
+		void resolveUniforms();
+		void setUniform(int16_t slot, const ShaderUniformValue &value);
+
+		ShaderSource readShader(std::string filename);
+		GLuint importShader(const ShaderSource &source); // returns shader id
+		void submit(std::vector<ShaderSource> &sources);
+
+		std::string getBinaryPath();
+		bool loadBinary(uint64_t hash);
+		void saveBinary(uint64_t hash);
 
-		GLuint importShader(std::string filename); // returns shader id
 		GLuint m_id;
 		std::string m_filename;
 		std::string m_prepend;
-		std::vector<std::pair<std::string, GLfloat*>> m_parameters_3f;
-		std::vector<std::pair<std::string, GLfloat>>  m_parameters_f;
-		std::vector<std::pair<std::string, GLint>>  m_parameters_i;
+		std::string m_cache_key;
+		bool m_from_cache;
+		uint64_t m_hash;	// of the driver and sources, identifies the cached binary
+
+		// Filenames and IDs of the shaders submitted, until finishLoad() is called
+		std::vector<std::pair<std::string, GLuint>> m_compiling;
+
+		// All active uniforms, the index is the slot; slots of pending values
+		std::vector<ShaderUniform> m_uniforms;
+		std::vector<int16_t> m_pending;
+
+		// Slots of the uniforms that use() sets for every shader
+		int16_t m_time_slot;
+		int16_t m_usc_slot;
+		int16_t m_seed_slot;
 };
 
 /// Manager for all Shaders, compiles and provides them
@@ -45,13 +124,55 @@ class ShaderManager
 
 		// request = execute
 		void requestShader(std::string filename);
+		void requestShader(int16_t id);
 
 		// get = retrieve Shader class
 		Shader *getShader(std::string fileame);
+		Shader *getShader(int16_t id);
+		int16_t getShaderID(std::string filename);
 		void resetShader();
 
 	private:
+		void activate(Shader *shader);
+
 		std::vector<Shader*> m_shaders;
+
+		// The default shader, bound by resetShader()
+		Shader *m_default;
+
+		// The shader that is currently in use, skip glUseProgram if requested again
+		Shader *m_current;
+};
+
+/**
+ * \brief Refers to a shader by its name, but only looks up the name once
+ *
+ * For objects that use a shader every frame: the first call to resolve() looks up the shader ID,
+ * afterwards it is requested by ID. Uniform slots should be looked up when resolve() returns true.
+ */
+class ShaderHandle
+{
+	public:
+		ShaderHandle(std::string name) :
+		m_name(name),
+		m_id(-1),
+		m_shader(nullptr) {};
+
+		bool resolve();
+		void request();
+
+		/// Shader ID as returned by ShaderManager::getShaderID, call resolve() first
+		int16_t getID()
+			{ return m_id; };
+
+		/// The shader, call resolve() first
+		Shader *operator->()
+			{ return m_shader; };
+
+	private:
+		std::string m_name;
+		int16_t m_id;
+		Shader *m_shader;
 };
 
 #endif
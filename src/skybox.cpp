@@ -1,5 +1,6 @@
 #include "gllibs.hpp"
 #include "skybox.hpp"
+#include "glstate.hpp"
 #include "gamevars.hpp"
 
 GLfloat cubevertices[] =
@@ -34,7 +35,8 @@ GLfloat texcoords[] =
 	1, 0, 1, 1, 0, 1, 0, 0
 };
 
-SkyBox::SkyBox ()
+SkyBox::SkyBox () :
+m_shader("skybox")
 {
 	std::cout<<std::endl;
 	std::cout<<"###############"<<std::endl;
@@ -52,7 +54,7 @@ SkyBox::SkyBox ()
 
 SkyBox::~SkyBox ()
 {
-	glDeleteTextures(6, m_textures);
+	GLState::deleteTextures(6, m_textures);
 	std::cout<<"~SkyBox"<<std::endl;
 }
 
@@ -64,13 +66,14 @@ GLuint SkyBox::loadTexture(std::string name)
 	std::cout<<outname<<" [..]"<<std::flush;
 	GLuint tex = SOIL_load_OGL_texture (texPath(name).c_str(), SOIL_LOAD_RGBA,
 		 SOIL_CREATE_NEW_ID, SOIL_FLAG_NTSC_SAFE_RGB);
+	GLState::forgetTexture();
 	std::cout<<"\b\b\bOK]"<<std::endl;
 	return tex;
 }
 
 void SkyBox::renderSide(uint8_t side)
 {
-	glBindTexture(GL_TEXTURE_2D, m_textures[side]);
+	GLState::bindTexture(m_textures[side]);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -102,16 +105,16 @@ void SkyBox::renderSide(uint8_t side)
 void SkyBox::render()
 {
 	#if (USE_SKYBOX_SHADER == 1)
-	game->getCamera()->getShaderManager()->requestShader("skybox");
+	m_shader.request();
 	#endif
 
 	glPushMatrix();
-	glPushAttrib(GL_ENABLE_BIT);
+	GLState::pushAttrib(GL_ENABLE_BIT);
 	{
-		glEnable(GL_TEXTURE_2D);
-		glDisable (GL_DEPTH_TEST);
-		glDisable (GL_BLEND);
-		glDisable (GL_LIGHTING);
+		GLState::enable(GL_TEXTURE_2D);
+		GLState::disable (GL_DEPTH_TEST);
+		GLState::disable (GL_BLEND);
+		GLState::disable (GL_LIGHTING);
 
 		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
 		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
@@ -120,6 +123,6 @@ void SkyBox::render()
 			renderSide(i);
 
 	}
-	glPopAttrib();
+	GLState::popAttrib();
 	glPopMatrix();
 }
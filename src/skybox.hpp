@@ -1,5 +1,6 @@
 #include "gllibs.hpp"
 #include "objects.hpp"
+#include "shader.hpp"
 
 #ifndef _SKYBOX_H
 #define _SKYBOX_H
@@ -18,6 +19,8 @@ class SkyBox : public GenericObject
 		GLuint loadTexture(std::string name);
 		void renderSide(uint8_t side);
 
+		ShaderHandle m_shader;
+
 };
 
 #endif
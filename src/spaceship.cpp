@@ -9,6 +9,7 @@
 #include "gamevars.hpp"
 #include "shader.hpp"
 #include "camera.hpp"
+#include "mesh.hpp"
 #include "config.hpp"
 #include "gllibs.hpp"
 #include "player.hpp"
@@ -32,6 +33,8 @@
 
 SpaceShip::SpaceShip(SimpleVec3d pos, SimpleVec3d velocity, glm::quat quat, glm::quat velquat) :
 m_time(0),
+m_mesh(NULL),
+m_hull_shader("spaceship"),
 m_quat(quat),
 m_velquat(velquat),
 m_cambound(CAMERA_BOUND),
@@ -45,6 +48,10 @@ m_engine_running(false)
 	m_pos = pos;
 	m_velocity = velocity;
 
+	// Render with default shader first (route), the cockpit is translucent
+	m_material = MATERIAL_SPACESHIP;
+	m_translucent = true;
+
 	// Keyboard Callbacks
 	keyboard->registerCallback(process_keys_wrapper, this);
 	keyboard->registerKeyPressCallback(onKeyPress_wrapper, this);
@@ -66,6 +73,50 @@ SpaceShip::~SpaceShip()
 
 	//delete m_psource; is a WorldObject, will be deleted by WorldEnvironment
 	delete m_navigator;
+	delete m_mesh;
+}
+
+/**
+ * \brief Builds the geometry of the SpaceShip into a MeshBuffer
+ *
+ * The opaque hull and the translucent glass parts are separate index ranges, so the whole
+ * ship is drawn with one call per color. Must be called while the OpenGL context is current.
+ */
+void SpaceShip::buildMesh()
+{
+	MeshBuilder builder;
+
+	// Hull: main body, backside and left / right
+	SpaceShipPart hull = { builder.getIndexNum(), 0, SimpleColor(1.0, 1.0, 1.0, 1.0) };
+
+	builder.addBox(SimpleVec3d(-SPACESHIP_X, -SPACESHIP_Y, -SPACESHIP_Z),
+		SimpleVec3d(SPACESHIP_X, SPACESHIP_Y, SPACESHIP_Z));
+
+	for (int side = -1; side <= 1; side += 2)
+	{
+		SimpleVec3d back(side * SPACESHIP_X, 0, -SPACESHIP_Z);
+		builder.addSphere(back, SPACESHIP_Y, DETAIL, DETAIL);
+		builder.addCylinder(back, SimpleVec3d(0, 0, SPACESHIP_Z * 2), SPACESHIP_Y,
+			DETAIL, true);
+	}
+
+	hull.count = builder.getIndexNum() - hull.first;
+	m_parts.push_back(hull);
+
+	// Glass: front and cockpit
+	SpaceShipPart glass = { builder.getIndexNum(), 0, SimpleColor(0, 0.1, 0.4, 0.5) };
+
+	builder.addCylinder(SimpleVec3d(-SPACESHIP_X, 0, SPACESHIP_Z),
+		SimpleVec3d(SPACESHIP_X * 2, 0, 0), SPACESHIP_Y, DETAIL, false);
+	builder.addSphere(SimpleVec3d(-SPACESHIP_X, 0, SPACESHIP_Z), SPACESHIP_Y, DETAIL, DETAIL);
+	builder.addSphere(SimpleVec3d( SPACESHIP_X, 0, SPACESHIP_Z), SPACESHIP_Y, DETAIL, DETAIL);
+	builder.addDodecahedron(SimpleVec3d(0, 0, 0), SPACESHIP_Y);
+
+	glass.count = builder.getIndexNum() - glass.first;
+	m_parts.push_back(glass);
+
+	m_mesh = new MeshBuffer(MESH_NORMALS);
+	builder.upload(m_mesh);
 }
 
 void SpaceShip::render ()
@@ -91,81 +142,15 @@ void SpaceShip::render ()
 
 	glRotated(180, 0, 1, 0);
 
-	game->getCamera()->getShaderManager()->requestShader("spaceship");
-
-	// Main body:
-	SimpleVec3d p1(-SPACESHIP_X, -SPACESHIP_Y, -SPACESHIP_Z);
-	SimpleVec3d p2( SPACESHIP_X,  SPACESHIP_Y,  SPACESHIP_Z);
-	makeCuboid(p1, p2, 3, 3, 3);
+	m_hull_shader.request();
 
-	// Backside
-	glPushMatrix();
-	{
-		glTranslatef(-SPACESHIP_X, 0, -SPACESHIP_Z);
-		glutSolidSphere(SPACESHIP_Y, DETAIL, DETAIL);
-	}
-	glPopMatrix();
-
-	glPushMatrix();
-	{
-		glTranslatef(SPACESHIP_X, 0, -SPACESHIP_Z);
-		glutSolidSphere(SPACESHIP_Y, DETAIL, DETAIL);
-	}
-	glPopMatrix();
-
-
-	// Left / Right
-	glPushMatrix();
-	{
-		glTranslatef(SPACESHIP_X, 0, -SPACESHIP_Z);
-		makeCylinder(SPACESHIP_Y, SPACESHIP_Z*2, DETAIL);
-	}
-	glPopMatrix();
-
-	glPushMatrix();
-	{
-		glTranslatef(-SPACESHIP_X, 0, -SPACESHIP_Z);
-		makeCylinder(SPACESHIP_Y, SPACESHIP_Z*2, DETAIL);
-	}
-	glPopMatrix();
-
-
-	// Front
-	glPushMatrix();
-	{
-		glColor4f(0, 0.1, 0.4, 0.5);
-		glTranslatef(-SPACESHIP_X, 0, SPACESHIP_Z);
-		glRotatef(90, 0, 1, 0);
-		GLUquadric* qobj = gluNewQuadric();
-		gluQuadricNormals(qobj, GLU_SMOOTH);
-		gluCylinder(qobj, SPACESHIP_Y, SPACESHIP_Y, (SPACESHIP_X*2), DETAIL, DETAIL);
-	}
-	glPopMatrix();
-
-	glPushMatrix();
-	{
-		glColor4f(0, 0.1, 0.4, 0.5);
-		glTranslatef(-SPACESHIP_X, 0, SPACESHIP_Z);
-		glutSolidSphere(SPACESHIP_Y, DETAIL, DETAIL);
-	}
-	glPopMatrix();
-
-	glPushMatrix();
-	{
-		glColor4f(0, 0.1, 0.4, 0.5);
-		glTranslatef(SPACESHIP_X, 0, SPACESHIP_Z);
-		glutSolidSphere(SPACESHIP_Y, 100, 100);
-	}
-	glPopMatrix();
+	if (m_mesh == NULL) buildMesh();
 
-	// Cockpit
-	glPushMatrix();
+	for (auto &part : m_parts)
 	{
-		glColor4f(0, 0.1, 0.4, 0.5);
-		glScalef(SPACESHIP_Y, SPACESHIP_Y, SPACESHIP_Y);
-		glutSolidDodecahedron();
+		part.color.set();
+		m_mesh->renderRange(GL_TRIANGLES, part.first, part.count);
 	}
-	glPopMatrix();
 }
 
 void SpaceShip::bindCamera(float dtime)
@@ -1,6 +1,7 @@
 #include "navigation.hpp"
 #include "quatutil.hpp"
 #include "objects.hpp"
+#include "shader.hpp"
 #include "audio.hpp"
 #include "util.hpp"
 
@@ -10,6 +11,7 @@
 
 class Player;
 class Navigator;
+class MeshBuffer;
 class FireParticleSource;
 
 enum CamBindType
@@ -20,6 +22,14 @@ enum CamBindType
 	CAMERA_FREE
 };
 
+/// Range of indices in the SpaceShip mesh that is drawn in one color
+struct SpaceShipPart
+{
+	uint32_t first;
+	uint32_t count;
+	SimpleColor color;
+};
+
 /// The SpaceShip the player can use to travel in the solar system
 class SpaceShip : public PhysicalObject, public AudioObject
 {
@@ -59,9 +69,16 @@ class SpaceShip : public PhysicalObject, public AudioObject
 			{ return m_navigator; }
 
 	private:
+		void buildMesh();
+
 		float m_time;
 		FireParticleSource *m_psource;
 
+		// Geometry of the ship, built by the first render() call
+		MeshBuffer *m_mesh;
+		std::vector<SpaceShipPart> m_parts;
+		ShaderHandle m_hull_shader;
+
 		glm::quat m_quat; // saves orientation in space
 		glm::quat m_velquat; // saves rotational velocity
 		glm::quat m_accquat; // saves rotational acceleration
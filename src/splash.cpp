@@ -1,9 +1,57 @@
+#include <algorithm>
 #include <fstream>
 #include <string>
 #include "gllibs.hpp"
 
 #include "drawutil.hpp"
 #include "splash.hpp"
+#include "glstate.hpp"
+
+// Height of the progress bar at the bottom of the splashscreen, relative to the window
+#define SPLASH_PROGRESS_HEIGHT 0.01
+
+// The splashscreen that was drawn last, kept for drawSplashProgress
+static Image2d *splash_img = nullptr;
+
+/**
+ * \brief Draws the current splashscreen and a progress bar on top of it
+ * \param progress Fraction of the bar to fill, negative to draw no bar
+ */
+static void drawSplashImage(float progress)
+{
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+	GLState::pushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT);
+	{
+		GLState::disable(GL_DEPTH_TEST);
+		GLState::disable(GL_LIGHTING);
+		splash_img->render();
+
+		if (progress >= 0)
+		{
+			float x = -1 + 2 * std::min(progress, 1.0f);
+			float y = -1 + 2 * SPLASH_PROGRESS_HEIGHT;
+			glColor4f(1, 1, 1, 1);
+			glBegin(GL_QUADS);
+				glVertex3f(-1, -1, 1);
+				glVertex3f( x, -1, 1);
+				glVertex3f( x,  y, 1);
+				glVertex3f(-1,  y, 1);
+			glEnd();
+		}
+	}
+	GLState::popAttrib();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+
+	glFlush();
+	glutSwapBuffers();
+}
 
 void drawSplashScreen_abstract(std::string screensfile)
 {
@@ -20,25 +68,13 @@ void drawSplashScreen_abstract(std::string screensfile)
 
 	float width  = glutGet(GLUT_WINDOW_WIDTH);
 	float height = glutGet(GLUT_WINDOW_WIDTH);
-	Image2d img(splashfile, -1, 1, 2, -2);
+	delete splash_img;
+	splash_img = new Image2d(splashfile, -1, 1, 2, -2);
 
 	glMatrixMode(GL_PROJECTION);
 	glOrtho(0, width, 0, height, -10, 10);
 
-	glPushMatrix();
-	glLoadIdentity();
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	{
-		img.render();
-	}
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-	glMatrixMode(GL_MODELVIEW);
-
-	glFlush();
-	glutSwapBuffers();
+	drawSplashImage(-1);
 }
 
 void drawSplashScreen()
@@ -50,3 +86,15 @@ void drawLoseScreen()
 {
 	drawSplashScreen_abstract("losescreens");
 }
+
+/**
+ * \brief Draws the last splashscreen or losescreen again, with a progress bar
+ * \param progress Loading progress from 0 to 1
+ *
+ * Used while the game is loading, e.g. by the ShaderManager.
+ */
+void drawSplashProgress(float progress)
+{
+	if (splash_img == nullptr) return;
+	drawSplashImage(progress);
+}
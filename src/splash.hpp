@@ -9,5 +9,6 @@
 
 void drawSplashScreen();
 void drawLoseScreen();
+void drawSplashProgress(float progress);
 
 #endif
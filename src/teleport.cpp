@@ -9,14 +9,10 @@
 TeleportTarget *getTeleportTarget(std::string name)
 {
 	// Find TeleportTarget out of WorldEnvironment
-	for (auto obj : game->getWorldEnv()->getObjects())
+	for (auto &target : game->getWorldEnv()->getTeleportTargets())
 	{
-		TeleportTarget *target = dynamic_cast<TeleportTarget *>(obj);
-		if (target) // only if object is a TeleportTarget
-		{
-			if (target->getTeleportName() == name)
-				return target;
-		}
+		if (target.iface->getTeleportName() == name)
+			return target.iface;
 	}
 
 	return nullptr;
@@ -28,12 +24,8 @@ std::vector<std::string> getAllTeleportTargets()
 	targets.clear();
 
 	// Find all TeleportTargets out of WorldEnvironment
-	for (auto obj : game->getWorldEnv()->getObjects())
-	{
-		TeleportTarget *target = dynamic_cast<TeleportTarget *>(obj);
-		if (target) // only if object is a TeleportTarget
-			targets.push_back(target->getTeleportName());
-	}
+	for (auto &target : game->getWorldEnv()->getTeleportTargets())
+		targets.push_back(target.iface->getTeleportName());
 
 	return targets;
 }
@@ -16,26 +16,29 @@ void mouse_trigger_shot(int button, int state, int x, int y, void *unused)
 }
 
 Bullet::Bullet (Player *player) :
-PhysicalObject(),
+WorldObject(),
 m_time(0)
 {
 	m_pos = player->getPos() + player->getLookAxis() * 10;
-	m_velocity = player->getLookAxis() / 10;
-	m_acceleration = SimpleVec3d(0, -9.81 * USC * 1000, 0);
+	m_material = MATERIAL_EMISSIVE;
 
-	m_light.setLightID(GL_LIGHT0);
-	m_light.addLightInformationcolor(GL_DIFFUSE, SimpleColor(0.9, 0.9, 0.8, 1.0));
-	m_light.addLightInformationf (GL_QUADRATIC_ATTENUATION, 0.001);
+	EntityStore &entities = game->getWorldEnv()->getEntities();
+	m_entity = entities.create();
+	entities.getTransforms().add(m_entity, TransformComponent { m_pos });
+	entities.getKinematics().add(m_entity, KinematicsComponent {
+		player->getLookAxis() / 10, SimpleVec3d(0, -9.81 * USC * 1000, 0) });
 }
 
 Bullet::~Bullet()
 {
 	std::cout<<"~Bullet"<<std::endl;
+	game->getWorldEnv()->getEntities().destroy(m_entity);
 }
 
 void Bullet::render ()
 {
-	SimpleAngles angles = SimpleAngles(SimpleVec3d(m_velocity.x, m_velocity.y, m_velocity.z));
+	SimpleVec3d velocity = game->getWorldEnv()->getEntities().getKinematics().get(m_entity).velocity;
+	SimpleAngles angles = SimpleAngles(velocity);
 	glRotatef(angles.yaw   / PI * 180, 0.0f, 0.1f, 0.0f);
 	glRotatef(angles.pitch / PI * 180, 0.1f, 0.0f, 0.0f);
 
@@ -44,9 +47,13 @@ void Bullet::render ()
 	glutSolidCube(500 * USC);
 }
 
+void Bullet::stepMainThread (float dtime)
+{
+	m_pos = game->getWorldEnv()->getEntities().getTransforms().get(m_entity).pos;
+}
+
 void Bullet::step (float dtime)
 {
-	physicalMove(dtime);
 	m_time += dtime;
 	if (m_time > 20) m_obsolete = true;
 }
@@ -2,13 +2,14 @@
 #define TESTS_H
 
 #include "objects.hpp"
+#include "ecs.hpp"
 #include "player.hpp"
 #include "util.hpp"
 
 void mouse_trigger_shot(int button, int state, int x, int y, void *unused);
 
-/// Testing only!
-class Bullet : public PhysicalObject
+/// Testing only! Moved by the kinematics system of the WorldEnvironment's EntityStore
+class Bullet : public WorldObject
 {
 	public:
 		Bullet (Player *player);
@@ -16,8 +17,10 @@ class Bullet : public PhysicalObject
 
 		void render ();
 		void step (float dtime);
+		void stepMainThread (float dtime);
 
 	protected:
+		Entity m_entity;
 		float m_time;
 };
 
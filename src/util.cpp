@@ -2,8 +2,10 @@
 #include <sstream>
 #include <math.h>
 #include <string>
+#include <errno.h>
 
 #include "quatutil.hpp"
+#include "glstate.hpp"
 #include "config.hpp"
 #include "debug.hpp"
 #include "util.hpp"
@@ -103,26 +105,26 @@ SimpleAngles::SimpleAngles(SimpleVec3d v)
 void SimpleColor::setAmbient ()
 {
 	float color[] = {r, g, b, a};
-	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, color);
+	GLState::material(GL_AMBIENT, color);
 }
 
 void SimpleColor::setDiffuse ()
 {
 	float color[] = {r, g, b, a};
-	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, color);
+	GLState::material(GL_DIFFUSE, color);
 }
 
 void SimpleColor::setSpecular()
 {
 	float color[] = {r, g, b, a};
-	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, color);
+	GLState::material(GL_SPECULAR, color);
 }
 
 
 void SimpleColor::setEmission()
 {
 	float color[] = {r, g, b, a};
-	glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, color);
+	GLState::material(GL_EMISSION, color);
 }
 
 /*
@@ -180,11 +182,11 @@ void resetMaterial()
 	float emission[] = {0.0, 0.0, 0.0, 1.0};
 	float shininess  = 0;
 
-	glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT  , ambient  );
-	glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE  , diffuse  );
-	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR , specular );
-	glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION , emission );
-	glMaterialf (GL_FRONT_AND_BACK, GL_SHININESS, shininess);
+	GLState::material (GL_AMBIENT  , ambient  );
+	GLState::material (GL_DIFFUSE  , diffuse  );
+	GLState::material (GL_SPECULAR , specular );
+	GLState::material (GL_EMISSION , emission );
+	GLState::materialf(GL_SHININESS, shininess);
 
 	glColor4f(1, 1, 1, 1);
 }
@@ -259,3 +261,16 @@ std::string getBasedir()
 }
 
 #endif
+
+#ifdef PLANETHER_WINDOWS
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#endif
+
+bool makeDirectory(std::string path)
+{
+	if (mkdir(path.c_str(), 0755) == 0) return true;
+	return errno == EEXIST;
+}
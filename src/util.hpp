@@ -179,4 +179,7 @@ inline bool almostEqual(float a, float b, float maxdiff)
 // Get the current basedir path that the textures / shaders / sounds folders should be in
 std::string getBasedir();
 
+// Create a directory if it does not exist yet, returns true if it exists afterwards
+bool makeDirectory(std::string path);
+
 #endif